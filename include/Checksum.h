@@ -0,0 +1,11 @@
+// CRC-32 (IEEE 802.3) for on-disk records
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Pass a previous result as `crc` to checksum data in several pieces
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+#endif
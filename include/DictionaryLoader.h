@@ -0,0 +1,39 @@
+// Bulk builders for the dictionary trie
+#ifndef DICTIONARYLOADER_H
+#define DICTIONARYLOADER_H
+
+#include "TrieNode.h"
+#include <string>
+#include <string_view>
+
+using std::string;
+
+struct DictionaryLoader {
+    // Inserts every line of `text` (one word per line) into `root`, which
+    // must not be visible to other threads yet; returns the number of lines.
+    //
+    // With more than one thread, lines are split into chunks, routed to one
+    // bucket per first letter, and each bucket is built into its own subtree
+    // under root->children[i] by a separate thread. Buckets share no nodes, so
+    // the builders never contend, and because a trie's shape depends only on
+    // the multiset of words the result is node-for-node identical to inserting
+    // the lines one by one. threads == 0 means one per hardware thread.
+    static int loadLines(TrieNode* root, std::string_view text, unsigned threads = 0);
+
+    // Builds a new trie from `text` in one streaming pass if its lines are
+    // sorted (by the letters the trie keeps, duplicates allowed), else
+    // returns nullptr. Each word only descends from where it stops sharing a
+    // prefix with the previous one, and nodes are created in DFS pre-order in
+    // one contiguous block, so traversals walk memory mostly forwards. The
+    // result equals inserting the lines one by one; `lines` gets their number.
+    static TrieNode* buildSorted(std::string_view text, int& lines);
+
+    // Inserts every "word,frequency" line of `text` (the saveToFile format)
+    // into `root` with one counted insert each; returns the number of lines
+    // that parsed. The word is everything before the line's last comma.
+    // Delimiters are found 16 bytes at a time with SSE2 where available and
+    // the count is parsed with from_chars, so no locale or stream is involved.
+    static int loadFrequencies(TrieNode* root, std::string_view text);
+};
+
+#endif
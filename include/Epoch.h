@@ -0,0 +1,42 @@
+// Epoch-based memory reclamation for RCU-published data
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <cstddef>
+
+// Pins the calling thread to the current epoch for its lifetime. Anything
+// a reader loads from an RCU-published pointer while a guard is alive stays
+// valid until the guard is destroyed. Guards nest and are cheap: one
+// thread-local lookup and one atomic store on entry and exit.
+class EpochGuard {
+public:
+    EpochGuard();
+    ~EpochGuard();
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+// Writers unlink an object from every published structure first and then
+// retire it; it is freed once no guard that could still see it is alive.
+struct Epoch {
+    static void retire(void* ptr, void (*deleter)(void*));
+
+    template <typename T>
+    static void retire(T* ptr) {
+        retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    // Advances the global epoch if every pinned thread has caught up and
+    // frees whatever became unreachable. Called automatically from retire().
+    static void collect();
+
+    // Blocks until everything retired before the call has been freed.
+    // Must not be called while holding an EpochGuard.
+    static void drain();
+
+    // Number of retired objects still waiting to be freed.
+    static size_t pending();
+};
+
+#endif
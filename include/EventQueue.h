@@ -0,0 +1,60 @@
+// Bounded lock-free queue feeding the background history aggregator
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+struct IngestEvent {
+    enum class Kind : uint8_t {
+        CompleteSearch,  // /api/search:     search +10, user +10, user trie
+        UserWord         // /api/userword:   user +1, user trie
+    };
+
+    Kind kind;
+    string text;
+    std::chrono::steady_clock::time_point enqueued;
+};
+
+// Multi-producer, single-consumer ring buffer. Each slot carries a sequence
+// number that tells producers and the consumer whose turn it is, so a push
+// is one CAS on the tail plus one release store, and never waits on the
+// consumer. A push into a full ring fails instead of blocking.
+class EventQueue {
+public:
+    explicit EventQueue(size_t capacity);   // rounded up to a power of two
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    bool tryPush(IngestEvent&& event);
+
+    // Consumer side: moves up to `max` events into `out`, returns how many
+    size_t popBatch(vector<IngestEvent>& out, size_t max);
+
+    size_t capacity() const { return mask + 1; }
+    size_t depth() const;
+    uint64_t pushed() const { return enqueuePos.load(std::memory_order_acquire); }
+    uint64_t popped() const { return dequeuePos.load(std::memory_order_acquire); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        IngestEvent event;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+};
+
+#endif
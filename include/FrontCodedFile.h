@@ -0,0 +1,88 @@
+// Front-coded dictionary file (the saveToFile format)
+#ifndef FRONTCODEDFILE_H
+#define FRONTCODEDFILE_H
+
+#include "MappedFile.h"
+#include "TrieNode.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+using std::string;
+
+// File layout, host byte order:
+//   header   magic "ACFCDICT" | u32 version | u32 restart interval
+//            | u64 word count | u64 node count | u64 block count
+//            | u32 CRC-32 of the index | u32 zero
+//   blocks   up to `restart interval` entries each, in lexicographic order:
+//            varint shared prefix length | varint suffix length | suffix
+//            | varint frequency (at most INT_MAX). The prefix is shared
+//            with the previous entry of the same block, so every block
+//            starts with a whole word (a restart point) and decodes on its
+//            own.
+//   index    per block: u64 offset | u32 size | u32 CRC-32 of the block
+// The node count is what SortedTrieBuilder needs to build the trie in one
+// allocation; a reader can also seek to the block holding a word and
+// decode just that block.
+class FrontCodedFile {
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kRestartInterval = 32;
+
+    // Writes every word under `root` to `path` (via a temp file and
+    // rename), streaming with WordIterator; false on I/O errors. The caller
+    // keeps the trie alive.
+    static bool write(const TrieNode* root, const string& path);
+
+    // True if `data` starts with this format's magic
+    static bool recognizes(std::string_view data);
+
+    // Maps `path` and checks its header and index (blocks are checked as
+    // they are read); false, logging an error, if it is missing, of
+    // another version, truncated or corrupt
+    bool open(const string& path);
+
+    size_t words() const { return header.words; }
+    size_t blocks() const { return header.blocks; }
+
+    // Index of the last block whose first word is <= `word` (0 if none),
+    // i.e. the only block that can hold `word`
+    size_t findBlock(std::string_view word) const;
+
+    // Verifies and decodes block `block`, calling `fn(word, frequency)` per
+    // entry; stops and returns false if fn does, or if the block is corrupt
+    bool readBlock(size_t block,
+                   const std::function<bool(std::string_view, int)>& fn) const;
+
+    // Decodes every block straight into SortedTrieBuilder; nullptr, logging
+    // an error, if a block is corrupt
+    TrieNode* build() const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t restartInterval;
+        uint64_t words;
+        uint64_t nodes;
+        uint64_t blocks;
+        uint32_t indexCrc;
+        uint32_t reserved;
+    };
+    struct IndexEntry {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t crc;
+    };
+
+    IndexEntry entry(size_t block) const;
+    std::string_view firstWord(size_t block) const;
+
+    MappedFile file;
+    string name;
+    Header header{};
+    const char* index = nullptr;
+};
+
+#endif
@@ -0,0 +1,61 @@
+// On-disk user-history snapshots, binary and text
+#ifndef HISTORYFILE_H
+#define HISTORYFILE_H
+
+#include "HistorySnapshot.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+using std::string;
+
+// Binary layout, host byte order:
+//   header   magic "ACHISTRY" | u32 version | u32 CRC-32 of the header (with
+//            this field zero) | u64 checkpoint LSN | u64 user entries
+//            | u64 search entries
+//   blocks   u32 payload size | u32 CRC-32 of the payload | payload:
+//            u8 section | varint entry count | per entry varint word length
+//            | word | varint count
+// Blocks hold up to 64 KB of entries of one section; the header counts are
+// written last, so a file cut short anywhere is refused.
+//
+// The text format is the one saveUserHistory used to write: an optional
+// "[CHECKPOINT] <lsn>" line, then "word count" lines under "[USER_WORDS]"
+// and "[SEARCH_HISTORY]". It stays readable for import and hand editing.
+struct HistoryFile {
+    static constexpr uint32_t kVersion = 1;
+
+    enum class Section : uint8_t { UserWords = 0, SearchHistory = 1 };
+    using Sink = std::function<void(Section, std::string_view word, int count)>;
+
+    // Writes every entry of both counter maps to `path`: to a temp file that
+    // is fsynced, renamed over `path`, then the directory is fsynced. Once
+    // it returns true the new file is on disk, so whatever it replaces
+    // (such as a sealed write-ahead log) can go. False, logging an
+    // error, on I/O errors.
+    static bool write(const string& path, const PersistentCountMap& users,
+                      const PersistentCountMap& searches, uint64_t checkpoint);
+    static bool writeText(const string& path, const PersistentCountMap& users,
+                          const PersistentCountMap& searches, uint64_t checkpoint);
+
+    // Reads `path` in either format, calling `sink` once per word and
+    // section (in text, the last line for a word wins) and setting
+    // `checkpoint` (0 if none). False, logging an error, if the file
+    // cannot be opened or a binary file is of another version, truncated or
+    // corrupt; the sink may have seen part of it by then.
+    static bool read(const string& path, uint64_t& checkpoint, const Sink& sink);
+
+    // Rewrites `from` (either format) at `to` in binary, or in text if
+    // `text` is set; false if either side fails
+    static bool convert(const string& from, const string& to, bool text);
+
+    // Replaces the fsync the writers make on the temp file and then on its
+    // directory (both passed as an open descriptor plus the path); returns
+    // whether the sync succeeded. For tests; set it before any write runs,
+    // and reset it with an empty function.
+    using SyncHook = std::function<bool(int fd, const string& path)>;
+    static void setSyncHook(SyncHook hook);
+};
+
+#endif
@@ -0,0 +1,30 @@
+// Immutable view of the user-word and search-query counters
+#ifndef HISTORYSNAPSHOT_H
+#define HISTORYSNAPSHOT_H
+
+#include "PersistentCountMap.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::pair;
+
+// A snapshot is never modified after it is published; withUpdates() builds
+// the next version, which shares every node of the counter maps that a
+// batch of deltas does not reach (see PersistentCountMap).
+struct HistorySnapshot {
+    PersistentCountMap user;     // words added through /api/userword or complete searches
+    PersistentCountMap search;   // search queries and suggest prefixes
+    size_t userSize = 0;
+    size_t searchSize = 0;
+
+    int userCount(const string& word) const;
+    int searchCount(const string& query) const;
+
+    HistorySnapshot* withUpdates(const vector<pair<string, int>>& userDeltas,
+                                 const vector<pair<string, int>>& searchDeltas) const;
+};
+
+#endif
@@ -0,0 +1,65 @@
+// Lock-free latency histogram with HDR-style log-linear buckets
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using std::vector;
+
+// Counts nanosecond durations in buckets whose width grows with the value:
+// below 64 ns every value has its own bucket, and above that each power of
+// two is split into 32 equal buckets, so a reported value is within about
+// 3% of the recorded one. Durations from 2^40 ns (about 18 minutes) up are
+// counted in the last bucket. Recording is two relaxed atomic adds and
+// takes no lock; readers copy the counts without stopping writers.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kMaxBits = 40;
+    static constexpr size_t kBuckets = size_t(kMaxBits - kSubBucketBits + 1) << kSubBucketBits;
+
+    // A copy of the counts at one moment; records racing with the copy may
+    // be in the buckets and not yet in sumNs, or the other way round
+    struct Snapshot {
+        vector<uint64_t> counts;
+        uint64_t total = 0;
+        uint64_t sumNs = 0;
+
+        // The highest value in the bucket holding the q-th quantile
+        // (0 <= q <= 1), or 0 when nothing was recorded
+        uint64_t quantile(double q) const;
+    };
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t ns) {
+        counts[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        sumNs.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const;
+
+    static size_t bucketOf(uint64_t ns) {
+        constexpr uint64_t linear = uint64_t(2) << kSubBucketBits;
+        if (ns < linear) return size_t(ns);
+        if (ns >> kMaxBits) return kBuckets - 1;
+        int bits = 63 - __builtin_clzll(ns);
+        int shift = bits - kSubBucketBits;
+        return (size_t(shift) << kSubBucketBits) + size_t(ns >> shift);
+    }
+    // The range of values that share bucket i
+    static uint64_t lowestIn(size_t bucket);
+    static uint64_t highestIn(size_t bucket);
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::atomic<uint64_t> sumNs{0};
+};
+
+#endif
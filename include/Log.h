@@ -0,0 +1,148 @@
+// Leveled, asynchronous logging
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+enum class LogLevel : int { Debug = 0, Info, Warn, Error, Off };
+
+// Levels below this are compiled out: their statements, arguments included,
+// sit behind a constant-false branch and generate no code. The makefile
+// sets it from LOG_LEVEL (default 1, Info); build with LOG_LEVEL=0 for
+// debug output.
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL 1
+#endif
+
+class LogLine;
+
+// Records at or above the runtime level end up on stderr (or setOutput's
+// descriptor) as one line each,
+//     (2026-01-31 12:00:00) [INFO    ] message
+// A logging thread only copies the record's arguments, unformatted, into a
+// ring buffer of its own; one background writer drains every ring, formats
+// the records and writes them out in batches. Producers take no lock and
+// make no syscall, except that the first record after the writer has gone
+// idle wakes it through a condition variable; an idle writer sleeps until
+// then. A record that finds its thread's ring full is dropped and counted,
+// and the writer reports the count. Lines from different
+// threads are written in the order the writer finds them, which within one
+// drain pass is by thread rather than by time.
+//
+// A disabled level costs one relaxed load and a branch; arguments are only
+// evaluated when the record is kept.
+class Log {
+public:
+    static bool enabled(LogLevel level) {
+        return int(level) >= LOG_COMPILED_LEVEL &&
+               int(level) >= threshold.load(std::memory_order_relaxed);
+    }
+    static void setLevel(LogLevel level) { threshold.store(int(level)); }
+    static LogLevel level() { return LogLevel(threshold.load()); }
+    // "debug", "info", "warn", "error" or "off"; false for anything else
+    static bool parseLevel(std::string_view name, LogLevel& level);
+
+    // Where the writer sends lines (default STDERR_FILENO)
+    static void setOutput(int fd);
+    // Opens another channel that writes to `fd`, for records that belong in
+    // a file of their own (LogLine's `channel`). Returns the channel, or -1
+    // once all kChannels are taken.
+    static constexpr int kChannels = 4;
+    static int addOutput(int fd);
+    // Returns once every record logged before the call is written. Also run
+    // at exit.
+    static void flush();
+    // Records dropped on full rings, and records written, since start, as
+    // of the writer's last pass
+    static uint64_t dropped();
+    static uint64_t written();
+
+private:
+    friend class LogLine;
+    static void submit(const LogLine& line);
+
+    static std::atomic<int> threshold;
+};
+
+// One record, collected with << and handed to the writer when it goes out
+// of scope. Strings are copied, numbers stored in binary; other types are
+// formatted here with their operator<<. A record is capped at kMaxBytes,
+// past which arguments are cut and the line marked as truncated.
+class LogLine {
+public:
+    static constexpr size_t kMaxBytes = 1024;
+
+    // Argument tags in the encoded record
+    enum Tag : char { Text = 's', Signed = 'i', Unsigned = 'u', Real = 'd', Char = 'c' };
+
+    // Channel 0 is the main log; see Log::addOutput for the others
+    explicit LogLine(LogLevel level, int channel = 0);
+    ~LogLine() { Log::submit(*this); }
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& operator<<(std::string_view text);
+    LogLine& operator<<(const char* text) { return *this << std::string_view(text ? text : "(null)"); }
+    LogLine& operator<<(const std::string& text) { return *this << std::string_view(text); }
+    LogLine& operator<<(char c) { return put(Char, &c, 1); }
+    LogLine& operator<<(bool b) { return *this << int(b); }
+    LogLine& operator<<(double value) { return put(Real, &value, sizeof(value)); }
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    LogLine& operator<<(T value) {
+        if constexpr (std::is_signed_v<T>) {
+            int64_t wide = value;
+            return put(Signed, &wide, sizeof(wide));
+        } else {
+            uint64_t wide = value;
+            return put(Unsigned, &wide, sizeof(wide));
+        }
+    }
+
+    template <typename T, std::enable_if_t<!std::is_arithmetic_v<T> &&
+                                           !std::is_convertible_v<const T&, std::string_view>,
+                                           int> = 0>
+    LogLine& operator<<(const T& value) {
+        std::ostringstream text;
+        text << value;
+        return *this << text.str();
+    }
+
+private:
+    friend class Log;
+
+    LogLine& put(Tag tag, const void* value, size_t size) {
+        if (used + 1 + size > kMaxBytes) {
+            truncated = true;
+            return *this;
+        }
+        data[used] = tag;
+        std::memcpy(data + used + 1, value, size);
+        used += 1 + size;
+        return *this;
+    }
+
+    LogLevel level;
+    uint8_t channel;
+    int64_t timeNs;
+    bool truncated = false;
+    size_t used = 0;
+    char data[kMaxBytes];
+};
+
+// LOG_INFO << "Loaded " << count << " words";
+// (qualified, since crow declares a LogLevel of its own)
+#define LOG_AT(level) if (!::Log::enabled(level)) {} else ::LogLine(level)
+#define LOG_DEBUG LOG_AT(::LogLevel::Debug)
+#define LOG_INFO LOG_AT(::LogLevel::Info)
+#define LOG_WARN LOG_AT(::LogLevel::Warn)
+#define LOG_ERROR LOG_AT(::LogLevel::Error)
+
+#endif
@@ -0,0 +1,35 @@
+// Read-only memory map of a whole file
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+using std::string;
+
+// The file's pages are read on first touch and shared with the page cache,
+// so loading a large list costs no copy into a heap buffer. The view stays
+// valid until the MappedFile is destroyed.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file cannot be opened or mapped; an empty file maps to an
+    // empty view
+    bool open(const string& path);
+
+    std::string_view text() const {
+        return std::string_view(static_cast<const char*>(data), size);
+    }
+
+private:
+    void* data = nullptr;
+    size_t size = 0;
+};
+
+#endif
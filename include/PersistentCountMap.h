@@ -0,0 +1,91 @@
+// Immutable string -> count map whose updates share everything they do not touch
+#ifndef PERSISTENTCOUNTMAP_H
+#define PERSISTENTCOUNTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::pair;
+
+// Estimated footprint of one counter map
+struct HistoryMemoryStats {
+    size_t entries = 0;
+    size_t nodes = 0;
+    size_t keyBytes = 0;   // characters in the keys
+    size_t bytes = 0;      // nodes, child links, entries and keys too long to store inline
+};
+
+// A hash trie: inner nodes branch on the next kBits of the key's hash and
+// leaves hold up to kLeafCapacity entries sorted by hash. Nodes are never
+// modified once built. withDeltas() copies only the leaves its deltas land
+// in and the inner nodes on the way to them, so publishing a batch costs
+// time and memory in proportion to the batch, not to the map; every other
+// node is shared with the map it started from.
+class PersistentCountMap {
+public:
+    static constexpr int kBits = 5;
+    static constexpr size_t kFanout = size_t(1) << kBits;
+    static constexpr size_t kLeafCapacity = 32;
+
+    size_t size() const { return count; }
+
+    // 0 if the key is absent
+    int find(const string& key) const;
+
+    // A map with each delta added to its key's count (a key that is not
+    // there starts from 0; entries are never removed). Deltas may repeat
+    // a key.
+    PersistentCountMap withDeltas(const vector<pair<string, int>>& deltas) const;
+
+    // Calls fn(key, count) once per entry, in hash order
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        if (root) visit(*root, fn);
+    }
+
+    // Walks every node, so it takes time linear in the map's size
+    HistoryMemoryStats memoryStats() const;
+
+    // Entries held in nodes this map does not share with `base`: what
+    // building it from `base` copied
+    size_t entriesNotSharedWith(const PersistentCountMap& base) const;
+
+private:
+    struct Entry {
+        uint64_t hash;
+        string key;
+        int count;
+    };
+    // A leaf has entries and no children; an inner node has kFanout
+    // children, null where no key's hash leads
+    struct Node {
+        vector<Entry> entries;
+        vector<std::shared_ptr<const Node>> children;
+    };
+    using NodePtr = std::shared_ptr<const Node>;
+    struct Delta;
+
+    template <typename Fn>
+    static void visit(const Node& node, Fn& fn) {
+        for (const Entry& entry : node.entries) fn(entry.key, entry.count);
+        for (const NodePtr& child : node.children) {
+            if (child) visit(*child, fn);
+        }
+    }
+
+    static size_t slot(uint64_t hash, int level);
+    static NodePtr update(const NodePtr& node, const Delta* begin, const Delta* end,
+                          int level, size_t& added);
+    static std::shared_ptr<Node> split(const Node& leaf, int level);
+
+    NodePtr root;
+    size_t count = 0;
+};
+
+#endif
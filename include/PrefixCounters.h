@@ -0,0 +1,59 @@
+// Per-thread counters for suggest prefixes
+#ifndef PREFIXCOUNTERS_H
+#define PREFIXCOUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+
+// Absorbs the per-request `searchHistory[prefix]++` without touching shared
+// state: every thread increments its own table, guarded by a mutex that only
+// the merger ever contends on. drain() swaps all tables out so the owner can
+// fold them into the published history in one batch.
+class PrefixCounters {
+public:
+    using CountMap = std::unordered_map<string, int>;
+
+    explicit PrefixCounters(size_t localLimit);
+
+    PrefixCounters(const PrefixCounters&) = delete;
+    PrefixCounters& operator=(const PrefixCounters&) = delete;
+
+    // Counts one hit on the calling thread's table and returns how many
+    // distinct keys that table now holds: 1 right after a drain, and
+    // limit() or more once a merge is due.
+    size_t add(const string& key);
+    size_t limit() const { return localLimit.load(std::memory_order_relaxed); }
+
+    // Hits counted but not yet drained, summed over every thread. Increments
+    // racing with the call may or may not be included.
+    int pending(const string& key) const;
+    size_t pendingKeys() const;
+
+    CountMap drain();
+
+    void setLocalLimit(size_t limit) { localLimit.store(limit); }
+
+private:
+    struct alignas(64) Slot {
+        std::mutex mutex;
+        CountMap counts;
+    };
+
+    Slot& local();
+
+    const uint64_t id;   // distinguishes instances in the thread-local cache
+    std::atomic<size_t> localLimit;
+    mutable std::mutex slotsMutex;
+    vector<unique_ptr<Slot>> slots;   // one per thread that ever counted
+};
+
+#endif
@@ -0,0 +1,91 @@
+// Static tracepoints (USDT) on the completion pipeline
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <cstdint>
+
+// Each PROBEn(name, ...) site compiles to a single nop plus an ELF note in
+// .note.stapsdt that records the nop's address and where its arguments
+// live, in the format SystemTap's <sys/sdt.h> uses, so bpftrace, perf and
+// bcc can attach to a running server:
+//     bpftrace -e 'usdt:./autocomplete_system:autocomplete:query__done { ... }'
+// Nothing runs unless a tracer patches the nop. Arguments are passed as
+// signed 64-bit values already in registers (strings as pointers).
+//
+// Every probe also has a semaphore that tracers increment while attached;
+// PROBE_ENABLED(name) reads it, so a site can skip work done only for the
+// probe, such as counting nodes. Add a new probe's semaphore to the list
+// below and to src/Probes.cpp.
+//
+// Only x86-64 and AArch64 get probes; elsewhere, or when built with
+// -DNO_PROBES, the macros compile to nothing.
+#if (defined(__x86_64__) || defined(__aarch64__)) && !defined(NO_PROBES)
+#define PROBES_ACTIVE 1
+#else
+#define PROBES_ACTIVE 0
+#endif
+
+#if PROBES_ACTIVE
+
+// The tracer's attach counts, one per probe, in a section of their own
+#define PROBE_SEMAPHORE(name) autocomplete_##name##_semaphore
+extern "C" {
+extern volatile unsigned short PROBE_SEMAPHORE(request__start);
+extern volatile unsigned short PROBE_SEMAPHORE(request__done);
+extern volatile unsigned short PROBE_SEMAPHORE(query__start);
+extern volatile unsigned short PROBE_SEMAPHORE(query__done);
+extern volatile unsigned short PROBE_SEMAPHORE(collect__start);
+extern volatile unsigned short PROBE_SEMAPHORE(collect__done);
+extern volatile unsigned short PROBE_SEMAPHORE(history__save__start);
+extern volatile unsigned short PROBE_SEMAPHORE(history__save__done);
+}
+
+#define PROBE_ENABLED(name) __builtin_expect(PROBE_SEMAPHORE(name) != 0, 0)
+
+#define PROBE_ARG(value) "r"((int64_t)(uintptr_t)(value))
+
+// The note: nop address, the link-time base tracers use to relocate it,
+// the semaphore, then provider, name and argument locations as strings
+#define PROBE_NOTE(name, args, ...)                                             \
+    __asm__ __volatile__(                                                       \
+        "990: nop\n"                                                            \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n"                           \
+        ".balign 4\n"                                                           \
+        ".4byte 992f-991f, 994f-993f, 3\n"                                      \
+        "991: .asciz \"stapsdt\"\n"                                             \
+        "992: .balign 4\n"                                                      \
+        "993: .8byte 990b\n"                                                    \
+        ".8byte _.stapsdt.base\n"                                               \
+        ".8byte autocomplete_" #name "_semaphore\n"                             \
+        ".asciz \"autocomplete\"\n"                                             \
+        ".asciz \"" #name "\"\n"                                                \
+        ".asciz \"" args "\"\n"                                                 \
+        "994: .balign 4\n"                                                      \
+        ".popsection\n"                                                         \
+        ".ifndef _.stapsdt.base\n"                                              \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n"                                                \
+        ".hidden _.stapsdt.base\n"                                              \
+        "_.stapsdt.base: .space 1\n"                                            \
+        ".size _.stapsdt.base, 1\n"                                             \
+        ".popsection\n"                                                         \
+        ".endif\n"                                                              \
+        :: __VA_ARGS__)
+
+#define PROBE0(name) PROBE_NOTE(name, "")
+#define PROBE1(name, a) PROBE_NOTE(name, "-8@%0", PROBE_ARG(a))
+#define PROBE2(name, a, b) PROBE_NOTE(name, "-8@%0 -8@%1", PROBE_ARG(a), PROBE_ARG(b))
+#define PROBE3(name, a, b, c) \
+    PROBE_NOTE(name, "-8@%0 -8@%1 -8@%2", PROBE_ARG(a), PROBE_ARG(b), PROBE_ARG(c))
+
+#else
+
+#define PROBE_ENABLED(name) false
+#define PROBE0(name) do {} while (0)
+#define PROBE1(name, a) do {} while (0)
+#define PROBE2(name, a, b) do {} while (0)
+#define PROBE3(name, a, b, c) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+// Per-route request latency and status counts for /api/metrics
+#ifndef REQUESTMETRICS_H
+#define REQUESTMETRICS_H
+
+#include "LatencyHistogram.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+
+// One latency histogram and one counter per status code for each route
+// named at construction, plus an "other" slot for any other path so that
+// unknown URLs cannot grow the table. Recording takes no lock.
+class RequestMetrics {
+public:
+    explicit RequestMetrics(vector<string> routes);
+
+    RequestMetrics(const RequestMetrics&) = delete;
+    RequestMetrics& operator=(const RequestMetrics&) = delete;
+
+    // The slot for a request path (without its query string)
+    size_t route(std::string_view path) const;
+
+    void record(size_t route, int status, uint64_t ns);
+    // Counts a request that was answered without being timed
+    void record(size_t route, int status);
+
+    // Prometheus text exposition: a latency summary per route with the
+    // 0.5, 0.9, 0.99 and 0.999 quantiles, and a request counter per route
+    // and status code
+    string prometheus() const;
+
+private:
+    static constexpr int kLowestStatus = 100;
+    static constexpr int kStatuses = 500;   // 100 to 599
+
+    struct Route {
+        string name;
+        LatencyHistogram latency;
+        std::atomic<uint64_t> statuses[kStatuses] = {};
+    };
+
+    vector<unique_ptr<Route>> routes;
+};
+
+#endif
@@ -0,0 +1,72 @@
+// Suggest requests that took longer than a threshold
+#ifndef SLOWQUERYLOG_H
+#define SLOWQUERYLOG_H
+
+#include "Trie.h"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+struct SlowQuery {
+    int64_t unixMs;      // when it finished
+    string prefix;
+    int64_t totalNs;     // the whole request, serialization included
+    bool traced;         // one of the sampled requests; only they have the times
+    QueryTrace trace;    // the counts, always; the per-phase times if traced
+    uint64_t threadId;   // the kernel's id for the worker, as top and perf show it
+};
+
+// Keeps the last `capacity` slow queries in memory for /api/debug/slow and,
+// once open() succeeds, also writes each as one line to a file of its own
+// through the asynchronous logger. Every request comes with its candidate
+// and traversal counts, which autoCompleteSystem keeps anyway; the caller
+// times the whole request, which is two clock reads, and times each phase
+// only for the one in kTraceEvery per thread that sampleTrace() picks. Only
+// slow ones take the mutex.
+class SlowQueryLog {
+public:
+    static constexpr unsigned kTraceEvery = 16;
+
+    // A threshold <= 0 turns the log off
+    SlowQueryLog(int64_t thresholdNs, size_t capacity);
+
+    SlowQueryLog(const SlowQueryLog&) = delete;
+    SlowQueryLog& operator=(const SlowQueryLog&) = delete;
+
+    // Appends lines to `path`; false if it cannot be opened or the logger
+    // has no channel left, in which case queries are only kept in memory
+    bool open(const string& path);
+
+    bool enabled() const { return thresholdNs > 0; }
+    int64_t threshold() const { return thresholdNs; }
+
+    // Whether the calling thread's next request should have its phases
+    // timed so that, if it turns out slow, the breakdown is kept. False
+    // when off.
+    bool sampleTrace() const;
+
+    // Keeps and writes the query if it reached the threshold; `traced` says
+    // whether `trace` has the per-phase times
+    void offer(const string& prefix, int64_t totalNs, const QueryTrace& trace, bool traced);
+
+    // Oldest first
+    vector<SlowQuery> recent() const;
+    // Slow queries seen since start, including those the ring has let go
+    uint64_t recorded() const;
+
+private:
+    const int64_t thresholdNs;
+    const size_t capacity;
+    int channel = -1;
+
+    mutable std::mutex mutex;
+    std::deque<SlowQuery> queries;
+    uint64_t total = 0;
+};
+
+#endif
@@ -0,0 +1,44 @@
+// Streaming trie construction from words in sorted order
+#ifndef SORTEDTRIEBUILDER_H
+#define SORTEDTRIEBUILDER_H
+
+#include "TrieNode.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Each word only descends from where it stops sharing a prefix with the
+// previous one (whose path is kept as a stack), and nodes are taken in
+// creation order, which is DFS pre-order, from one block of exactly the
+// size the caller counted up front. Used by DictionaryLoader::buildSorted
+// and by the front-coded dictionary reader.
+class SortedTrieBuilder {
+public:
+    // `nodes` counts the root plus, per word, the letters it does not share
+    // with the previous word
+    explicit SortedTrieBuilder(size_t nodes);
+    ~SortedTrieBuilder();   // frees the trie unless finish() took it
+
+    SortedTrieBuilder(const SortedTrieBuilder&) = delete;
+    SortedTrieBuilder& operator=(const SortedTrieBuilder&) = delete;
+
+    // Adds `count` occurrences of `word`, which holds only 'a'-'z' and is
+    // not smaller than the previous word. False, adding nothing, if it is
+    // out of order or would need more nodes than were counted.
+    bool add(std::string_view word, int count);
+
+    // Hands over the trie (its root owns the block)
+    TrieNode* finish();
+
+private:
+    TrieNode* block;
+    size_t capacity;
+    size_t used = 1;
+    string prev;
+    vector<TrieNode*> path;   // path[d]: the previous word's node at depth d
+};
+
+#endif
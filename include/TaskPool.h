@@ -0,0 +1,52 @@
+// Work-stealing thread pool for fork-join traversals
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+using std::unique_ptr;
+
+// Every worker owns a deque: it pops its own tasks from the back and, when
+// that runs dry, steals from the front of the others. The thread that forks
+// a batch helps run it instead of blocking, so runAll() can be called from
+// any thread that is not itself a pool worker.
+class TaskPool {
+public:
+    explicit TaskPool(unsigned threads);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    // Runs every task and returns once all of them have finished
+    void runAll(vector<std::function<void()>>& tasks);
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool runOne(unsigned self);   // own queue first, then steal; false if all empty
+    void workerLoop(unsigned self);
+
+    vector<unique_ptr<Queue>> queues;
+    vector<std::thread> workers;
+    std::atomic<unsigned> nextQueue{0};
+    std::atomic<long> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif
@@ -2,41 +2,283 @@
 #define TRIE_H
 
 #include "TrieNode.h"
+#include "HistorySnapshot.h"
+#include "EventQueue.h"
+#include "PrefixCounters.h"
+#include "TaskPool.h"
+#include "WriteAheadLog.h"
 #include <string>
 #include <vector>
 #include <memory>
-#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 using std::string;
 using std::vector;
 using std::unique_ptr;
 
+// Counters for the asynchronous ingestion pipeline and its persistence
+struct IngestStats {
+    size_t depth;            // events waiting in the queue
+    size_t capacity;
+    uint64_t enqueued;
+    uint64_t applied;
+    uint64_t dropped;        // pushes rejected because the queue was full
+    uint64_t batches;
+    double lastApplyLagMs;   // enqueue-to-visible time of the newest batch's oldest event
+    double maxApplyLagMs;
+    uint64_t prefixMerges;   // thread-local prefix tables folded into the history
+    size_t pendingPrefixKeys;
+    size_t walBytes;         // size of the current write-ahead log
+    uint64_t walSyncs;
+    uint64_t walFailedAppends;   // records not logged because a write failed
+    uint64_t walFailedSyncs;     // fdatasync errors; records since may not be on disk
+    uint64_t compactions;    // write-ahead log folded into a new snapshot
+    int64_t snapshotIntervalMs;
+    double lastSnapshotAgeMs;      // since the last snapshot landed; -1 if none
+    double lastSnapshotWriteMs;    // serializing and renaming, outside any lock
+    double lastSnapshotPauseMs;    // history writers blocked while it is captured
+    double maxSnapshotPauseMs;
+};
+
+// State of background dictionary reloads
+struct ReloadStats {
+    bool running;
+    uint64_t completed;      // dictionaries swapped in
+    uint64_t failed;         // neither source could be loaded
+    int lastWords;           // size of the last dictionary swapped in
+    double lastBuildMs;
+};
+
+// What the tries and the history counters take up (/api/debug/memory)
+struct MemoryStats {
+    TrieMemoryStats dictionary;
+    TrieMemoryStats userTrie;
+    HistoryMemoryStats userHistory;     // userHistory: per-word user counts
+    HistoryMemoryStats searchHistory;   // searchHistory: queries and suggest prefixes
+};
+
+// What one autoCompleteSystem call did and, when timed, where it spent its
+// time (/api/suggest?trace=1). The candidate and traversal counts are kept
+// on every call; the *Ns fields only on a timed one. serializeNs is the
+// caller's.
+struct QueryTrace {
+    CollectStats user;        // user-trie descent and traversal
+    CollectStats dict;        // the same for the dictionary, if it was needed
+    bool dictConsulted = false;
+    size_t userCandidates = 0;  // words each trie's top-k collection returned
+    size_t dictCandidates = 0;
+    int64_t boostNs = 0;      // history lookups that boost the user-trie results
+    int64_t mergeSortNs = 0;  // folding in dictionary words (and their boosts), sorting
+    int64_t serializeNs = 0;
+    int64_t totalNs = 0;      // the whole autoCompleteSystem call
+};
+
+// Thread safety: every public method may be called concurrently from crow's
+// worker threads. Readers never take a lock: they pin an epoch (see Epoch.h)
+// and load the tries and the history counters through atomic pointers.
+// Words are inserted into the tries in place with CAS (see TrieNode), so
+// user-trie inserts run concurrently without any lock. The history counters
+// are immutable snapshots; their writers, and bulk loads that build and
+// publish a whole new dictionary, serialize on `writeMutex` and retire the
+// version they replaced.
+//
+// Request handlers do not write shared state: complete searches and user
+// words are pushed onto a lock-free queue, suggest prefixes are counted in
+// per-thread tables, and one background aggregator thread owned by the Trie
+// applies both in batches.
 class Trie {
 public:
     Trie();
-    ~Trie() = default;
+    ~Trie();
+    
+    Trie(const Trie&) = delete;
+    Trie& operator=(const Trie&) = delete;
     
-    void insert(const string& word);
+    void insert(const string& word, int count = 1);
     void insertUserWord(const string& word);
     bool search(const string& word) const;
     
     // CHANGED: Remove const to allow internal recording
-    vector<string> autoCompleteSystem(const string& prefix, int maxSuggestion = 10);
+    // With `trace`, reports the candidates and traversal counts, and with
+    // `timed` also times each phase
+    vector<string> autoCompleteSystem(const string& prefix, int maxSuggestion = 10,
+                                      QueryTrace* trace = nullptr, bool timed = false);
     
     // New methods for search query tracking
     void recordSearchQuery(const string& query);
     void recordCompleteSearch(const string& query);
     
+    // Longest query or word the history takes: the write-ahead log cannot
+    // replay a longer record
+    static constexpr size_t kMaxTextBytes = WriteAheadLog::kMaxText;
+    
+    // Asynchronous counterparts of recordCompleteSearch / insertUserWord:
+    // they only enqueue, and return false if the event had to be dropped or
+    // its text is longer than kMaxTextBytes.
+    bool submitCompleteSearch(const string& query);
+    bool submitUserWord(const string& word);
+    
+    // Makes the user history durable: loads `snapshotFile`, replays the
+    // records of `walFile` logged after it, then appends every mutation the
+    // aggregator applies to `walFile` before publishing it. The log is folded
+    // into a new snapshot by a background thread, every
+    // `options.compactInterval` or once the log passes `options.compactBytes`.
+    // Call once, before serving. False, with no log open, if the snapshot is
+    // damaged (see HistoryFile) or the log cannot be opened.
+    bool openHistoryLog(const string& snapshotFile, const string& walFile,
+                        const WalOptions& options = WalOptions());
+    // Writes a snapshot of the history now and starts a fresh log
+    void compactHistoryLog();
+    // Blocks until every event submitted and every prefix counted before the
+    // call is applied.
+    void flushEvents();
+    IngestStats ingestStats() const;
+    
+    // Suggest prefixes are merged into the published search history every
+    // `interval`, or sooner once one thread has counted `localLimit` distinct
+    // prefixes. Ranking reads only the merged counts, never another thread's
+    // table, so it sees a prefix's count at most about `interval` (plus one
+    // batch apply) late; searchCount() adds the unmerged hits and is not
+    // stale.
+    void setPrefixMerge(std::chrono::milliseconds interval, size_t localLimit);
+    
+    // Opt-in fork-join collection for dictionary prefixes whose subtree holds
+    // at least `minSubtreeWords` words, on a pool of `threads` workers;
+    // minSubtreeWords == 0 turns it off (the default). Call before serving.
+    void setParallelCollection(int minSubtreeWords, unsigned threads);
+    
+    // Current counts, including prefix hits not merged yet
+    int searchCount(const string& query) const;
+    int userCount(const string& word) const;
+    
+    // Loads one word per line into the dictionary and publishes the result
+    // once; returns the number of lines read, or -1 if the file cannot be
+    // opened. The build runs on `threads` threads (0: all cores), see
+    // DictionaryLoader::loadLines.
+    int loadWordList(const string& filename, unsigned threads = 0);
+    
+    // Streams every dictionary word as a "word,frequency" line, in
+    // lexicographic order, handing `sink` about `chunkBytes` at a time; stops
+    // early when sink returns false. Memory stays at one chunk plus the
+    // current path. The trie it walks is pinned until the export ends.
+    void exportDictionary(const std::function<bool(std::string_view)>& sink,
+                          size_t chunkBytes = 64 << 10) const;
+    // Replaces the dictionary with one built from a word list, in one
+    // streaming pass if the file is sorted (see DictionaryLoader::buildSorted)
+    // and by insertion on all cores otherwise. Readers keep using the old
+    // dictionary until the new one is published. Returns the number of
+    // lines, or -1 if the file cannot be opened.
+    int buildFromSorted(const string& filename);
+    // Builds a new dictionary on a background thread, from `indexFile` if it
+    // is a valid index (empty: skip) and otherwise from `wordList`, then
+    // swaps it in. The user trie and the histories are untouched; queries
+    // already running finish on the old dictionary, which is reclaimed after
+    // them. Returns false if a reload is already running.
+    bool reloadDictionary(const string& indexFile, const string& wordList);
+    ReloadStats reloadStats() const;
+    
+    // Walks both tries and every history entry of the published versions;
+    // meant for debugging and capacity planning, not for hot paths
+    MemoryStats memoryStats() const;
+    
+    // Replaces the dictionary with a prebuilt index (see TrieIndex and
+    // `make indexer`); returns the number of words, or -1 if the index is
+    // missing, stale in version or corrupt.
+    int loadIndex(const string& filename);
+    
+    // Writes the dictionary as a front-coded file (see FrontCodedFile); sorted
+    // words share prefixes, so it is much smaller than exportDictionary's text
     void saveToFile(const string& filename) const;
+    // Adds the counts in `filename`, front-coded or "word,frequency" text,
+    // to the dictionary. A front-coded file loaded into an empty dictionary
+    // is built in one pass by SortedTrieBuilder and swapped in.
     void loadFromFile(const string& filename);
+    // Writes the history in HistoryFile's binary format; loadUserHistory
+    // reads that or the older text format, and loaded counts replace
+    // existing ones
     void saveUserHistory(const string& filename) const;
     void loadUserHistory(const string& filename);
 
 private:
-    unique_ptr<TrieNode> root;
-    unique_ptr<TrieNode> userRoot;
-    std::unordered_map<string, int> userHistory;
-    std::unordered_map<string, int> searchHistory;  // New: tracks search queries
+    // Builds a private copy of the trie behind `slot`, lets `fill` mutate it
+    // in place and publishes it; caller holds writeMutex
+    void rebuildPublished(std::atomic<TrieNode*>& slot,
+                          const std::function<void(TrieNode*)>& fill);
+    // Publishes the current history plus the given deltas; caller holds writeMutex
+    void updateHistory(const vector<pair<string, int>>& userDeltas,
+                       const vector<pair<string, int>>& searchDeltas);
+    
+    bool submit(IngestEvent::Kind kind, const string& text);
+    // Wakes the aggregator if it sleeps; `prefixOnly` for a producer that
+    // only added prefix counts, which a sleep with a merge scheduled will
+    // pick up on its own
+    void wakeAggregator(bool prefixOnly = false);
+    void aggregatorLoop();
+    void applyBatch(const vector<IngestEvent>& batch);
+    void mergePrefixCounts();
+    // Appends the batch's net changes to the log; caller holds writeMutex
+    void logMutations(WalOp op, const std::unordered_map<string, int>& counts);
+    void snapshotLoop();
+    void requestSnapshot();
+    // Sets `checkpoint` to the LSN recorded in the file (0 if none or no
+    // file); false if the file exists but cannot be read
+    bool loadHistoryFile(const string& filename, uint64_t& checkpoint);
+
+    std::atomic<TrieNode*> root;
+    std::atomic<TrieNode*> userRoot;
+    unique_ptr<TaskPool> collectPool;
+    int parallelThreshold = 0;
+    std::atomic<HistorySnapshot*> history;   // userHistory + searchHistory
+
+    mutable std::mutex writeMutex;   // serializes publishers
+    mutable std::mutex saveMutex;    // serializes writers of the same file
+    
+    EventQueue events;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> applied{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<int64_t> lastApplyLagNs{0};
+    std::atomic<int64_t> maxApplyLagNs{0};
+    std::mutex aggregatorMutex;
+    std::condition_variable aggregatorWake;   // work arrived, or stopping
+    std::condition_variable appliedWake;      // `applied` moved (flushEvents)
+    bool aggregatorWoken = false;             // guarded by aggregatorMutex
+    std::atomic<int> aggregatorSleep{0};      // see AggregatorSleep in Trie.cpp
+    
+    PrefixCounters prefixCounts;
+    std::atomic<int64_t> prefixMergeIntervalMs;
+    std::atomic<bool> prefixMergeDue{false};
+    std::atomic<uint64_t> prefixMerges{0};
+    std::mutex prefixMergeMutex;     // one drain-and-publish at a time
+    
+    std::atomic<WriteAheadLog*> wal{nullptr};   // set once by openHistoryLog
+    string snapshotPath;
+    string walPath;
+    std::atomic<uint64_t> compactions{0};
+    std::atomic<uint64_t> compactedLsn{0};
+    std::atomic<int64_t> lastSnapshotAt{0};       // steady clock, ns
+    std::atomic<int64_t> lastSnapshotWriteNs{0};
+    std::atomic<int64_t> lastSnapshotPauseNs{0};
+    std::atomic<int64_t> maxSnapshotPauseNs{0};
+    std::mutex snapshotMutex;
+    std::condition_variable snapshotWake;
+    bool snapshotRequested = false;  // guarded by snapshotMutex
+    std::atomic<bool> stopping{false};
+    std::mutex reloadMutex;          // guards `reloader` itself
+    std::atomic<bool> reloading{false};
+    std::atomic<uint64_t> reloadsCompleted{0};
+    std::atomic<uint64_t> reloadsFailed{0};
+    std::atomic<int> lastReloadWords{0};
+    std::atomic<int64_t> lastReloadNs{0};
+    std::thread reloader;
+    
+    std::thread snapshotter;         // started by openHistoryLog
+    std::thread aggregator;          // last: starts once everything above exists
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+// Prebuilt binary dictionary index
+#ifndef TRIEINDEX_H
+#define TRIEINDEX_H
+
+#include "TrieNode.h"
+#include <cstdint>
+#include <string>
+
+using std::string;
+
+// File layout, host byte order:
+//   header   magic "ACTRIEIX" | u32 version | u32 CRC-32 of the body
+//            | u64 node count | u64 word count
+//   nodes    u32 per node in DFS pre-order: bits 0-25 say which children
+//            exist, bit 31 marks the end of a word
+//   words    i32 frequency per word, in the same (lexicographic) order
+// The shape alone determines every child pointer, so loading is a single
+// forward pass with no parsing and no lookups from the root.
+struct TrieIndex {
+    static constexpr uint32_t kVersion = 1;
+
+    // Writes the trie under `root` to `path` (via a temp file and rename);
+    // false on I/O errors
+    static bool write(const TrieNode* root, const string& path);
+
+    // Maps and verifies `path` and rebuilds the trie in one node block (see
+    // TrieNode::allocateBlock); this is a faster build, still linear in the
+    // dictionary, not a trie served from the mapping. nullptr if the file
+    // does not exist, and also, logging an error, if it cannot be
+    // read or is of another version, truncated or corrupt. `words` gets the
+    // number of distinct words.
+    static TrieNode* load(const string& path, size_t& words);
+};
+
+#endif
@@ -3,9 +3,12 @@
 #define TRIENODE_H
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <queue>
 #include <algorithm>
 #include <iostream>
@@ -15,6 +18,8 @@ using std::vector;
 using std::pair;
 using std::unique_ptr;
 
+class TaskPool;
+
 struct Suggestion {
     string word;
     int freq;
@@ -25,22 +30,93 @@ struct Suggestion {
     }
 };
 
+// What one getAllWithPrefix call did (see QueryTrace in Trie.h). The counts
+// are always filled in; the times only on a timed call.
+struct CollectStats {
+    int64_t descentNs = 0;       // walking down to the prefix's node
+    int64_t traversalNs = 0;     // collecting the top k below it
+    uint64_t nodesVisited = 0;   // below the prefix's node, that node included
+    uint64_t heapPushes = 0;
+    uint64_t heapPops = 0;       // evictions, plus draining the final heap
+    bool parallel = false;       // collected fork-join
+};
+
+// Shape and footprint of one trie, from a walk over every node
+struct TrieMemoryStats {
+    size_t nodes = 0;
+    size_t terminalNodes = 0;    // nodes that end a word
+    size_t heapNodes = 0;        // allocated one by one, each with malloc overhead
+    size_t bytes = 0;            // heap nodes, plus whole mappings for block-built tries
+    size_t childLinks = 0;
+    double averageFanout = 0;    // children per node that has any
+    double terminalRatio = 0;    // terminalNodes / nodes
+    double childSlotUse = 0;     // childLinks / (26 * nodes)
+    vector<size_t> depthHistogram;   // nodes at each depth; the root is depth 0
+};
+
+// Concurrent, insert-only node. Children are installed with a CAS and the
+// counters are atomic, so any number of threads may insert while others read:
+// a reader sees every insert that completed before it looked, and never a
+// half-linked node. Nodes are never unlinked; a whole trie is replaced by
+// publishing a new root and retiring the old one with destroyTree().
 struct TrieNode {
-    std::array<unique_ptr<TrieNode>, 26> children;
-    bool isEndOfWord;
-    int frequency;
+    // How the node was allocated, so destroyTree frees it the same way
+    enum class Storage : uint8_t {
+        Heap,         // on its own, by new
+        Block,        // inside a block from allocateBlock
+        BlockOwner    // first node of such a block; frees all of it
+    };
+    
+    std::array<std::atomic<TrieNode*>, 26> children;
+    std::atomic<bool> isEndOfWord;
+    Storage storage = Storage::Heap;
+    std::atomic<int> frequency;
+    std::atomic<int> wordCount;   // distinct words ending in this subtree, this node included
     
     TrieNode();
     ~TrieNode() = default;
     
-    void insert(const string& word);
+    TrieNode* child(int index) const {
+        return children[index].load(std::memory_order_acquire);
+    }
+    
+    // Adds `count` occurrences of `word` in one descent; count <= 0 is a no-op
+    void insert(std::string_view word, int count = 1);
+    
+    static TrieNode* cloneTree(const TrieNode* node);
+    // Frees a whole trie. A block is freed with its owner, so a tree that
+    // uses one must be destroyed from the owner (the bulk builders make it
+    // the root), never from a node below it.
+    static void destroyTree(TrieNode* node);
+    // `count` contiguous nodes; bulk builders lay a trie out in one
+    static TrieNode* allocateBlock(size_t count);
+    // Same shape, flags, frequencies and counts, node for node
+    static bool equalTree(const TrieNode* a, const TrieNode* b);
+    // Walks every node; safe alongside inserts, which it may or may not see
+    static TrieMemoryStats memoryStats(const TrieNode* root);
+    
     void insertUserWord(const string& word);
     bool search(const string& word) const;
     
+    // With `stats`, nodes visited and heap operations are added to it
     void autoComplete(const TrieNode* node, std::priority_queue<Suggestion>& heap, 
-                     int k, const string& currPrefix) const;
+                     int k, const string& currPrefix, CollectStats* stats = nullptr) const;
+    void autoCompleteParallel(const TrieNode* node, std::priority_queue<Suggestion>& heap,
+                              int k, const string& currPrefix, TaskPool& pool,
+                              CollectStats* stats = nullptr) const;
     
-    vector<pair<string, int>> getAllWithPrefix(const string& prefix, int k = 10) const;
+    // With a pool and a positive threshold, subtrees holding at least
+    // `parallelThreshold` words are collected fork-join: the subtree is split
+    // into tasks by word count, each task keeps its own top-k heap and the
+    // heaps are merged. The result is the same as the sequential one.
+    // `stats`, if given, is overwritten with the call's counts, and with its
+    // timings too if `timed`: two clock reads per phase, the only part of
+    // the bookkeeping that is not free.
+    vector<pair<string, int>> getAllWithPrefix(const string& prefix, int k = 10,
+                                               TaskPool* pool = nullptr,
+                                               int parallelThreshold = 0,
+                                               CollectStats* stats = nullptr,
+                                               bool timed = false) const;
     void sortResults(vector<pair<string, int>>& results) const;
 };
 
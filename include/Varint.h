@@ -0,0 +1,31 @@
+// LEB128 variable-length integers for on-disk formats
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <cstdint>
+#include <string>
+
+// Seven bits per byte, low bits first, high bit set on all but the last
+// byte: values below 128 take one byte, a u32 at most five, a u64 ten.
+inline void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += char(value | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+// Decodes one varint at `p`, never reading at or past `end`; returns the
+// byte after it, or nullptr if the input ends mid-varint or the value does
+// not fit in 64 bits
+inline const char* getVarint(const char* p, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = uint8_t(*p++);
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return p;
+    }
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,40 @@
+// Lazy in-order walk over the words of a trie
+#ifndef WORDITERATOR_H
+#define WORDITERATOR_H
+
+#include "TrieNode.h"
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Yields (word, frequency) in lexicographic order while holding only the
+// current path: memory is O(longest word), whatever the size of the trie.
+// Safe to run while others insert (a word inserted during the walk may or
+// may not be seen); the caller keeps the trie alive, e.g. with an
+// EpochGuard, until it is done.
+//
+//     for (WordIterator it(root); it.next();) use(it.word(), it.frequency());
+class WordIterator {
+public:
+    explicit WordIterator(const TrieNode* root);
+
+    // Moves to the next word; false once the walk is over
+    bool next();
+
+    const string& word() const { return current; }
+    int frequency() const { return freq; }
+
+private:
+    struct Frame {
+        const TrieNode* node;
+        int nextChild;   // -1 until the node's own word has been considered
+    };
+
+    vector<Frame> stack;
+    string current;
+    int freq = 0;
+};
+
+#endif
@@ -0,0 +1,110 @@
+// Append-only log of user-history mutations
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+using std::string;
+
+enum class WalOp : uint8_t {
+    CompleteSearch = 1,   // search +10, user +10, user trie   (per count)
+    UserWord = 2,         // user +1, user trie                 (per count)
+    PrefixHits = 3        // search +count
+};
+
+struct WalRecord {
+    uint64_t lsn;
+    WalOp op;
+    uint32_t count;
+    string text;
+};
+
+enum class WalSync {
+    EveryRecord,   // fdatasync after each record
+    GroupCommit,   // fdatasync once per applied batch
+    Interval       // fdatasync at most every `syncInterval`
+};
+
+struct WalOptions {
+    WalSync sync = WalSync::GroupCommit;
+    std::chrono::milliseconds syncInterval{50};
+    // Fold the log into a fresh snapshot once it grows past this many bytes
+    // or once this much time has passed with records in it
+    size_t compactBytes = 16 << 20;
+    std::chrono::seconds compactInterval{300};
+};
+
+// File layout: an 8-byte header ("ACWAL" plus version), then records of
+//   u32 payload size | u32 CRC-32 of payload | payload
+// where the payload is u64 lsn | u8 op | u32 count | text bytes, all in host
+// byte order. Replay stops at the first short or corrupt record, which is
+// where a crash mid-append leaves the tail; open() cuts the file there.
+class WriteAheadLog {
+public:
+    // Longest text a record holds; replay refuses a larger payload as corrupt
+    static constexpr size_t kMaxText = 1 << 20;
+
+    explicit WriteAheadLog(const WalOptions& options);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Calls `apply` for every intact record of the log at `path` with an
+    // LSN above `after`; returns the highest LSN seen (or `after`).
+    static uint64_t replay(const string& path, uint64_t after,
+                           const std::function<void(const WalRecord&)>& apply);
+
+    // Opens `path` for appending, dropping any torn tail; new records are
+    // numbered from nextLsn
+    bool open(const string& path, uint64_t nextLsn);
+    bool isOpen() const;
+
+    // Returns the record's LSN, or 0 if it could not be written or its text
+    // is longer than kMaxText; a failed write is cut off again, so the
+    // records after it still replay
+    uint64_t append(WalOp op, const string& text, uint32_t count);
+    void commit();      // end of a group of appends; syncs per policy
+    void syncIfDue();   // for the Interval policy, called when idle
+    // True if records are written but not synced yet; `at` is then when
+    // syncIfDue() will sync them
+    bool syncPending(std::chrono::steady_clock::time_point& at) const;
+
+    // Renames the current file to `sealedPath` and starts an empty one in
+    // its place; `lastLsn` is set to the last LSN in the sealed file. If the
+    // rename fails, returns false and keeps appending to the current file.
+    bool rotate(const string& sealedPath, uint64_t& lastLsn);
+
+    const WalOptions& options() const { return opts; }
+    size_t bytes() const;
+    uint64_t lastLsn() const;
+    uint64_t syncs() const;
+    uint64_t failedAppends() const;   // records lost to write errors or too long
+    uint64_t failedSyncs() const;
+
+private:
+    // Writes at `size`; on error cuts the file back to `size` and returns false
+    bool writeAll(const void* data, size_t count);
+    // A failed fdatasync is counted, not retried: the kernel may already
+    // have dropped the pages it could not write, so a retry would report
+    // success for data that is not on disk
+    void sync();
+
+    const WalOptions opts;
+    mutable std::mutex mutex;
+    string path;
+    int fd = -1;
+    size_t size = 0;
+    uint64_t nextLsn = 1;
+    uint64_t syncCount = 0;
+    uint64_t failedCount = 0;
+    uint64_t failedSyncCount = 0;
+    bool dirty = false;
+    std::chrono::steady_clock::time_point lastSync;
+};
+
+#endif
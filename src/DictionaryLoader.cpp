@@ -0,0 +1,225 @@
+#include "DictionaryLoader.h"
+#include "SortedTrieBuilder.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <thread>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using std::string_view;
+
+namespace {
+
+constexpr int kBuckets = 26;
+
+// Calls f(line) for each line the way getline would split `text`
+template <typename F>
+void forEachLine(string_view text, F f) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == string_view::npos) end = text.size();
+        f(text.substr(pos, end - pos));
+        pos = end + 1;
+    }
+}
+
+// Calls f(line, comma) for each line the way getline would split `text`,
+// where `comma` is the offset of the line's last ',' or npos
+template <typename F>
+void forEachRecord(string_view text, F f) {
+    const char* data = text.data();
+    size_t size = text.size();
+    size_t lineStart = 0;
+    size_t comma = string_view::npos;
+    auto delimiter = [&](size_t at) {
+        if (data[at] == ',') {
+            comma = at - lineStart;
+            return;
+        }
+        f(text.substr(lineStart, at - lineStart), comma);
+        lineStart = at + 1;
+        comma = string_view::npos;
+    };
+    
+    size_t i = 0;
+#ifdef __SSE2__
+    // One compare per delimiter gives a bit per byte; walk the set bits
+    const __m128i newlines = _mm_set1_epi8('\n');
+    const __m128i commas = _mm_set1_epi8(',');
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(block, newlines), _mm_cmpeq_epi8(block, commas)));
+        while (mask) {
+            delimiter(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (data[i] == '\n' || data[i] == ',') delimiter(i);
+    }
+    if (lineStart < size) f(text.substr(lineStart), comma);
+}
+
+// The letters of `line` the trie keeps, in order
+void lettersOf(string_view line, string& out) {
+    out.clear();
+    for (char ch : line) {
+        if (ch >= 'a' && ch <= 'z') out += ch;
+    }
+}
+
+size_t commonPrefix(const string& a, const string& b) {
+    size_t n = std::min(a.size(), b.size());
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) i++;
+    return i;
+}
+
+// Parses a count the way `istream >> int` would, without locale lookups:
+// leading blanks are skipped and parsing stops at the first non-digit
+bool parseCount(string_view field, int& value) {
+    size_t at = 0;
+    while (at < field.size() && (field[at] == ' ' || field[at] == '\t')) at++;
+    if (at < field.size() && field[at] == '+') at++;
+    auto result = std::from_chars(field.data() + at, field.data() + field.size(), value);
+    return result.ec == std::errc();
+}
+
+// Index of the first letter TrieNode::insert would descend on, or -1
+int firstLetter(string_view word, size_t& at) {
+    for (at = 0; at < word.size(); ++at) {
+        char ch = word[at];
+        if (ch >= 'a' && ch <= 'z') return ch - 'a';
+    }
+    return -1;
+}
+
+struct Chunk {
+    string_view text;
+    std::vector<string_view> buckets[kBuckets];   // word tails after the first letter
+    int lines = 0;
+    int letterless = 0;   // lines that end on the root itself
+};
+
+} // namespace
+
+int DictionaryLoader::loadLines(TrieNode* root, string_view text, unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    
+    if (threads == 1) {
+        int count = 0;
+        forEachLine(text, [&](string_view line) {
+            root->insert(line);
+            count++;
+        });
+        return count;
+    }
+    
+    // Split at line boundaries into one chunk per thread
+    std::vector<Chunk> chunks(threads);
+    size_t begin = 0;
+    for (unsigned i = 0; i < threads; ++i) {
+        size_t end = (i + 1 == threads) ? text.size() : text.size() * (i + 1) / threads;
+        if (end < begin) end = begin;
+        if (end < text.size()) {
+            size_t nl = text.find('\n', end);
+            end = (nl == string_view::npos) ? text.size() : nl + 1;
+        }
+        chunks[i].text = text.substr(begin, end - begin);
+        begin = end;
+    }
+    
+    // Route every line of every chunk to its first-letter bucket
+    std::vector<std::thread> workers;
+    for (Chunk& chunk : chunks) {
+        workers.emplace_back([&chunk] {
+            forEachLine(chunk.text, [&](string_view line) {
+                chunk.lines++;
+                size_t at;
+                int bucket = firstLetter(line, at);
+                if (bucket < 0) chunk.letterless++;
+                else chunk.buckets[bucket].push_back(line.substr(at + 1));
+            });
+        });
+    }
+    for (auto& w : workers) w.join();
+    workers.clear();
+    
+    // Build each bucket's subtree on its own; workers take buckets in turn
+    std::atomic<int> nextBucket{0};
+    for (unsigned t = 0; t < std::min<unsigned>(threads, kBuckets); ++t) {
+        workers.emplace_back([&] {
+            for (int b = nextBucket++; b < kBuckets; b = nextBucket++) {
+                TrieNode* subtree = root->child(b);
+                for (const Chunk& chunk : chunks) {
+                    for (string_view tail : chunk.buckets[b]) {
+                        if (!subtree) subtree = new TrieNode();
+                        subtree->insert(tail);
+                    }
+                }
+                root->children[b].store(subtree, std::memory_order_release);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    
+    // The bucket builders counted words inside their own subtrees only
+    int words = root->isEndOfWord ? 1 : 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        if (const TrieNode* child = root->child(i)) words += child->wordCount;
+    }
+    root->wordCount.store(words);
+    
+    int count = 0;
+    for (const Chunk& chunk : chunks) {
+        for (int i = 0; i < chunk.letterless; ++i) root->insert("");
+        count += chunk.lines;
+    }
+    return count;
+}
+
+TrieNode* DictionaryLoader::buildSorted(string_view text, int& lines) {
+    // First pass: check the order and count the nodes the build will create
+    string prev;
+    string word;
+    size_t nodes = 1;
+    lines = 0;
+    bool sorted = true;
+    forEachLine(text, [&](string_view line) {
+        if (!sorted) return;
+        lettersOf(line, word);
+        if (lines > 0 && word < prev) {
+            sorted = false;
+            return;
+        }
+        nodes += word.size() - commonPrefix(prev, word);
+        prev.swap(word);
+        lines++;
+    });
+    if (!sorted) return nullptr;
+    
+    // Second pass: the order is known good, so every add succeeds
+    SortedTrieBuilder builder(nodes);
+    forEachLine(text, [&](string_view line) {
+        lettersOf(line, word);
+        builder.add(word, 1);
+    });
+    return builder.finish();
+}
+
+int DictionaryLoader::loadFrequencies(TrieNode* root, string_view text) {
+    int count = 0;
+    forEachRecord(text, [&](string_view line, size_t comma) {
+        int freq;
+        if (comma == string_view::npos || !parseCount(line.substr(comma + 1), freq)) return;
+        root->insert(line.substr(0, comma), freq);
+        count++;
+    });
+    return count;
+}
@@ -0,0 +1,136 @@
+#include "Epoch.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Quiescent threads publish 0; a pinned thread publishes the global epoch it
+// observed when it entered its outermost guard.
+constexpr uint64_t kQuiescent = 0;
+
+// Retire calls between automatic collection attempts
+constexpr size_t kCollectInterval = 64;
+
+struct alignas(64) ThreadRecord {
+    std::atomic<uint64_t> epoch{kQuiescent};
+    std::atomic<bool> inUse{false};
+    ThreadRecord* next = nullptr;
+};
+
+struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;
+};
+
+std::atomic<uint64_t> globalEpoch{1};
+std::atomic<ThreadRecord*> records{nullptr};   // append-only, never freed
+
+std::mutex limboMutex;
+std::vector<Retired> limbo;
+
+ThreadRecord* acquireRecord() {
+    for (ThreadRecord* r = records.load(std::memory_order_acquire); r; r = r->next) {
+        bool expected = false;
+        if (!r->inUse.load(std::memory_order_relaxed) &&
+            r->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+            return r;
+    }
+    ThreadRecord* r = new ThreadRecord();
+    r->inUse.store(true, std::memory_order_relaxed);
+    r->next = records.load(std::memory_order_relaxed);
+    while (!records.compare_exchange_weak(r->next, r, std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+    return r;
+}
+
+// Owns this thread's record; hands it back for reuse when the thread exits.
+struct LocalState {
+    ThreadRecord* record = acquireRecord();
+    int depth = 0;
+
+    ~LocalState() {
+        record->epoch.store(kQuiescent, std::memory_order_release);
+        record->inUse.store(false, std::memory_order_release);
+    }
+};
+
+LocalState& local() {
+    thread_local LocalState state;
+    return state;
+}
+
+// Moves the global epoch forward by one if no pinned thread lags behind it.
+bool tryAdvance() {
+    uint64_t current = globalEpoch.load();
+    for (ThreadRecord* r = records.load(std::memory_order_acquire); r; r = r->next) {
+        uint64_t e = r->epoch.load();
+        if (e != kQuiescent && e != current) return false;
+    }
+    return globalEpoch.compare_exchange_strong(current, current + 1);
+}
+
+} // namespace
+
+EpochGuard::EpochGuard() {
+    LocalState& state = local();
+    if (state.depth++ == 0) {
+        // seq_cst store: ordered before every pointer load the reader makes
+        state.record->epoch.store(globalEpoch.load());
+    }
+}
+
+EpochGuard::~EpochGuard() {
+    LocalState& state = local();
+    if (--state.depth == 0) {
+        state.record->epoch.store(kQuiescent, std::memory_order_release);
+    }
+}
+
+void Epoch::retire(void* ptr, void (*deleter)(void*)) {
+    if (!ptr) return;
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(limboMutex);
+        // The caller already unlinked ptr with a seq_cst store, so any reader
+        // that can still reach it pinned an epoch no later than this one.
+        limbo.push_back({ptr, deleter, globalEpoch.load()});
+        count = limbo.size();
+    }
+    if (count % kCollectInterval == 0) collect();
+}
+
+void Epoch::collect() {
+    tryAdvance();
+
+    // An object retired in epoch e may still be held by readers pinned at e,
+    // and those can coexist with epoch e + 1, so it is safe from e + 2 on.
+    uint64_t safeBefore = globalEpoch.load() - 1;
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> lock(limboMutex);
+        auto keep = limbo.begin();
+        for (auto it = limbo.begin(); it != limbo.end(); ++it) {
+            if (it->epoch < safeBefore) ready.push_back(*it);
+            else *keep++ = *it;
+        }
+        limbo.erase(keep, limbo.end());
+    }
+    for (const Retired& r : ready) r.deleter(r.ptr);
+}
+
+void Epoch::drain() {
+    while (pending() > 0) {
+        collect();
+        if (pending() > 0) std::this_thread::yield();
+    }
+}
+
+size_t Epoch::pending() {
+    std::lock_guard<std::mutex> lock(limboMutex);
+    return limbo.size();
+}
@@ -0,0 +1,53 @@
+#include "EventQueue.h"
+
+EventQueue::EventQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    cells.reset(new Cell[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool EventQueue::tryPush(IngestEvent&& event) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &cells[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;   // the consumer has not freed this slot yet: full
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->event = std::move(event);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t EventQueue::popBatch(vector<IngestEvent>& out, size_t max) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    size_t count = 0;
+    while (count < max) {
+        Cell& cell = cells[pos & mask];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1) break;
+        out.push_back(std::move(cell.event));
+        cell.sequence.store(pos + mask + 1, std::memory_order_release);
+        ++pos;
+        ++count;
+    }
+    dequeuePos.store(pos, std::memory_order_release);
+    return count;
+}
+
+size_t EventQueue::depth() const {
+    size_t tail = enqueuePos.load(std::memory_order_acquire);
+    size_t head = dequeuePos.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
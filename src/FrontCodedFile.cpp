@@ -0,0 +1,224 @@
+#include "FrontCodedFile.h"
+#include "Checksum.h"
+#include "Log.h"
+#include "SortedTrieBuilder.h"
+#include "Varint.h"
+#include "WordIterator.h"
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const char kMagic[8] = {'A', 'C', 'F', 'C', 'D', 'I', 'C', 'T'};
+
+size_t commonPrefix(const string& a, const string& b) {
+    size_t n = std::min(a.size(), b.size());
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) i++;
+    return i;
+}
+
+} // namespace
+
+bool FrontCodedFile::recognizes(std::string_view data) {
+    return data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+bool FrontCodedFile::write(const TrieNode* root, const string& path) {
+    string temp = path + ".tmp";
+    std::ofstream out(temp, std::ios::binary);
+    if (!out) {
+        LOG_ERROR << "Cannot write dictionary " << path;
+        return false;
+    }
+    
+    // The header's counts are only known at the end; it is rewritten then
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.restartInterval = kRestartInterval;
+    header.nodes = 1;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    std::vector<IndexEntry> blockIndex;
+    uint64_t offset = sizeof(header);
+    string block;
+    string prev;   // the trie-wide previous word, for the node count
+    string blockPrev;
+    uint32_t entries = 0;
+    auto flush = [&] {
+        blockIndex.push_back({offset, (uint32_t)block.size(), crc32(block.data(), block.size())});
+        out.write(block.data(), (std::streamsize)block.size());
+        offset += block.size();
+        block.clear();
+        blockPrev.clear();
+        entries = 0;
+    };
+    for (WordIterator it(root); it.next();) {
+        const string& word = it.word();
+        header.nodes += word.size() - commonPrefix(prev, word);
+        prev = word;
+        
+        size_t shared = commonPrefix(blockPrev, word);
+        putVarint(block, shared);
+        putVarint(block, word.size() - shared);
+        block.append(word, shared, string::npos);
+        putVarint(block, (uint32_t)it.frequency());
+        blockPrev = word;
+        header.words++;
+        if (++entries == kRestartInterval) flush();
+    }
+    if (entries > 0) flush();
+    
+    header.blocks = blockIndex.size();
+    header.indexCrc = crc32(blockIndex.data(), blockIndex.size() * sizeof(IndexEntry));
+    out.write(reinterpret_cast<const char*>(blockIndex.data()),
+              (std::streamsize)(blockIndex.size() * sizeof(IndexEntry)));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+        LOG_ERROR << "Cannot write dictionary " << path;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool FrontCodedFile::open(const string& path) {
+    name = path;
+    if (!file.open(path)) {
+        LOG_ERROR << "Cannot open dictionary " << path;
+        return false;
+    }
+    std::string_view data = file.text();
+    if (data.size() < sizeof(header)) {
+        LOG_ERROR << "Dictionary " << path << " is truncated";
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (!recognizes(data)) {
+        LOG_ERROR << path << " is not a front-coded dictionary";
+        return false;
+    }
+    if (header.version != kVersion) {
+        LOG_ERROR << "Dictionary " << path << " has version " << header.version
+                  << ", expected " << kVersion;
+        return false;
+    }
+    
+    // Blocks are back to back between the header and the index, and no
+    // count can exceed what that many bytes could encode
+    size_t body = data.size() - sizeof(header);
+    bool valid = header.restartInterval > 0 && header.restartInterval <= (1u << 16) &&
+                 header.blocks <= body / sizeof(IndexEntry) &&
+                 header.words <= header.blocks * header.restartInterval &&
+                 header.words + header.restartInterval > header.blocks * header.restartInterval &&
+                 header.nodes > 0 && header.nodes <= body + 1;
+    if (valid) {
+        index = data.data() + data.size() - header.blocks * sizeof(IndexEntry);
+        valid = crc32(index, header.blocks * sizeof(IndexEntry)) == header.indexCrc;
+    }
+    uint64_t offset = sizeof(header);
+    for (size_t i = 0; valid && i < header.blocks; ++i) {
+        IndexEntry e = entry(i);
+        valid = e.offset == offset && e.size > 0;
+        offset += e.size;
+    }
+    if (!valid || offset != (uint64_t)(index - data.data())) {
+        LOG_ERROR << "Dictionary " << path << " is truncated or corrupt";
+        index = nullptr;
+        return false;
+    }
+    return true;
+}
+
+FrontCodedFile::IndexEntry FrontCodedFile::entry(size_t block) const {
+    IndexEntry e;
+    std::memcpy(&e, index + block * sizeof(IndexEntry), sizeof(e));
+    return e;
+}
+
+std::string_view FrontCodedFile::firstWord(size_t block) const {
+    // Blocks start at a restart point: shared length 0, then the whole word.
+    // Not checksummed here; a damaged block only misdirects the search, and
+    // readBlock refuses it.
+    IndexEntry e = entry(block);
+    const char* p = file.text().data() + e.offset;
+    const char* end = p + e.size;
+    uint64_t shared;
+    uint64_t length;
+    if (!(p = getVarint(p, end, shared)) || !(p = getVarint(p, end, length)) ||
+        length > (uint64_t)(end - p)) {
+        return {};
+    }
+    return std::string_view(p, length);
+}
+
+size_t FrontCodedFile::findBlock(std::string_view word) const {
+    size_t lo = 0;
+    size_t hi = header.blocks;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (firstWord(mid) <= word) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool FrontCodedFile::readBlock(size_t block,
+                               const std::function<bool(std::string_view, int)>& fn) const {
+    if (!index || block >= header.blocks) return false;
+    IndexEntry e = entry(block);
+    const char* p = file.text().data() + e.offset;
+    const char* end = p + e.size;
+    if (crc32(p, e.size) != e.crc) return false;
+    
+    string word;
+    while (p < end) {
+        uint64_t shared;
+        uint64_t length;
+        uint64_t freq;
+        if (!(p = getVarint(p, end, shared)) || shared > word.size() ||
+            !(p = getVarint(p, end, length)) || length > (uint64_t)(end - p)) {
+            return false;
+        }
+        word.resize(shared);
+        for (const char* c = p; c < p + length; ++c) {
+            if (*c < 'a' || *c > 'z') return false;
+        }
+        word.append(p, length);
+        p += length;
+        // Frequencies are ints in the trie; a larger one would read back negative
+        if (!(p = getVarint(p, end, freq)) || freq > INT_MAX) return false;
+        if (!fn(word, (int)freq)) return false;
+    }
+    return true;
+}
+
+TrieNode* FrontCodedFile::build() const {
+    if (!index) return nullptr;
+    SortedTrieBuilder builder(header.nodes);
+    size_t count = 0;
+    for (size_t i = 0; i < header.blocks; ++i) {
+        bool valid = readBlock(i, [&](std::string_view word, int freq) {
+            count++;
+            return builder.add(word, freq);
+        });
+        if (!valid) {
+            LOG_ERROR << "Dictionary " << name << " has a corrupt block " << i;
+            return nullptr;
+        }
+    }
+    if (count != header.words) {
+        LOG_ERROR << "Dictionary " << name << " is inconsistent";
+        return nullptr;
+    }
+    return builder.finish();
+}
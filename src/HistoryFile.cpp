@@ -0,0 +1,306 @@
+#include "HistoryFile.h"
+#include "Checksum.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Varint.h"
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string_view;
+
+namespace {
+
+const char kMagic[8] = {'A', 'C', 'H', 'I', 'S', 'T', 'R', 'Y'};
+constexpr size_t kBlockBytes = 64 << 10;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t crc;
+    uint64_t checkpoint;
+    uint64_t users;
+    uint64_t searches;
+};
+
+uint32_t headerCrc(Header header) {
+    header.crc = 0;
+    return crc32(&header, sizeof(header));
+}
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// "word count" the way `istringstream >> word >> count` splits it
+bool parseEntry(string_view line, string_view& word, int& count) {
+    size_t start = 0;
+    while (start < line.size() && isSpace(line[start])) start++;
+    size_t end = start;
+    while (end < line.size() && !isSpace(line[end])) end++;
+    if (end == start) return false;
+    word = line.substr(start, end - start);
+    
+    while (end < line.size() && isSpace(line[end])) end++;
+    // from_chars takes a '-' but not a '+'
+    bool plus = end < line.size() && line[end] == '+';
+    if (plus && ++end < line.size() && line[end] == '-') return false;
+    return std::from_chars(line.data() + end, line.data() + line.size(), count).ec == std::errc();
+}
+
+bool readText(string_view text, uint64_t& checkpoint, const HistoryFile::Sink& sink) {
+    std::unordered_map<string, int> sections[2];
+    int current = 0;
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        string_view line = text.substr(0, newline);
+        text.remove_prefix(newline == string_view::npos ? text.size() : newline + 1);
+        
+        if (line.compare(0, 13, "[CHECKPOINT] ") == 0) {
+            checkpoint = std::strtoull(string(line.substr(13)).c_str(), nullptr, 10);
+        } else if (line == "[USER_WORDS]") {
+            current = 0;
+        } else if (line == "[SEARCH_HISTORY]") {
+            current = 1;
+        } else {
+            string_view word;
+            int count;
+            if (parseEntry(line, word, count)) sections[current][string(word)] = count;
+        }
+    }
+    for (int s = 0; s < 2; ++s) {
+        for (const auto& entry : sections[s]) {
+            sink(HistoryFile::Section(s), entry.first, entry.second);
+        }
+    }
+    return true;
+}
+
+bool readBinary(string_view data, uint64_t& checkpoint, const HistoryFile::Sink& sink,
+                const string& path) {
+    Header header;
+    if (data.size() < sizeof(header)) {
+        LOG_ERROR << "History " << path << " is truncated";
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.version != HistoryFile::kVersion) {
+        LOG_ERROR << "History " << path << " has version " << header.version
+                  << ", expected " << HistoryFile::kVersion;
+        return false;
+    }
+    if (headerCrc(header) != header.crc) {
+        LOG_ERROR << "History " << path << " is corrupt";
+        return false;
+    }
+    
+    uint64_t seen[2] = {0, 0};
+    const char* p = data.data() + sizeof(header);
+    const char* end = data.data() + data.size();
+    while (p < end) {
+        uint32_t size;
+        uint32_t crc;
+        if (end - p < 8) break;
+        std::memcpy(&size, p, 4);
+        std::memcpy(&crc, p + 4, 4);
+        p += 8;
+        if (size > (size_t)(end - p) || size == 0 || crc32(p, size) != crc) break;
+        const char* block = p;
+        const char* blockEnd = p + size;
+        p = blockEnd;
+        
+        uint8_t section = uint8_t(*block++);
+        uint64_t entries;
+        if (section > 1 || !(block = getVarint(block, blockEnd, entries))) break;
+        for (uint64_t i = 0; i < entries && block; ++i) {
+            uint64_t length;
+            uint64_t count;
+            if (!(block = getVarint(block, blockEnd, length)) ||
+                length > (uint64_t)(blockEnd - block)) {
+                block = nullptr;
+                break;
+            }
+            string_view word(block, length);
+            block += length;
+            if (!(block = getVarint(block, blockEnd, count)) || count > UINT32_MAX) {
+                block = nullptr;
+                break;
+            }
+            sink(HistoryFile::Section(section), word, (int)(uint32_t)count);
+        }
+        if (block != blockEnd) {
+            p = nullptr;
+            break;
+        }
+        seen[section] += entries;
+    }
+    if (p != end || seen[0] != header.users || seen[1] != header.searches) {
+        LOG_ERROR << "History " << path << " is truncated or corrupt";
+        return false;
+    }
+    checkpoint = header.checkpoint;
+    return true;
+}
+
+HistoryFile::SyncHook& syncHook() {
+    static HistoryFile::SyncHook hook;
+    return hook;
+}
+
+// fsyncs a file or a directory by path
+bool syncPath(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = syncHook() ? syncHook()(fd, path) : ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// Moves a fully written `temp` over `path` so that both the contents and
+// the new name survive a crash: the data must be on disk before the rename
+// can be, and the rename is only durable once the directory is synced
+bool replaceDurably(const string& temp, const string& path) {
+    if (!syncPath(temp) || std::rename(temp.c_str(), path.c_str()) != 0) return false;
+    size_t slash = path.rfind('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    return syncPath(directory);
+}
+
+} // namespace
+
+void HistoryFile::setSyncHook(SyncHook hook) {
+    syncHook() = std::move(hook);
+}
+
+bool HistoryFile::write(const string& path, const PersistentCountMap& users,
+                        const PersistentCountMap& searches, uint64_t checkpoint) {
+    // Written aside and renamed over the old file, so a crash leaves either
+    // the old snapshot or the new one
+    string temp = path + ".tmp";
+    std::ofstream out(temp, std::ios::binary);
+    if (!out) {
+        LOG_ERROR << "Cannot save user history to " << path;
+        return false;
+    }
+    
+    // The counts are only known at the end; the header is rewritten then
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.checkpoint = checkpoint;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    string body;
+    string block;
+    uint64_t entries = 0;
+    auto flush = [&](Section section) {
+        block.clear();
+        block += char(section);
+        putVarint(block, entries);
+        block += body;
+        uint32_t size = (uint32_t)block.size();
+        uint32_t crc = crc32(block.data(), block.size());
+        out.write(reinterpret_cast<const char*>(&size), 4);
+        out.write(reinterpret_cast<const char*>(&crc), 4);
+        out.write(block.data(), (std::streamsize)block.size());
+        body.clear();
+        entries = 0;
+    };
+    auto writeSection = [&](Section section, const PersistentCountMap& counts) {
+        uint64_t total = 0;
+        counts.forEach([&](const string& word, int count) {
+            putVarint(body, word.size());
+            body += word;
+            putVarint(body, (uint32_t)count);
+            entries++;
+            if (body.size() >= kBlockBytes) {
+                total += entries;
+                flush(section);
+            }
+        });
+        if (entries > 0) {
+            total += entries;
+            flush(section);
+        }
+        return total;
+    };
+    header.users = writeSection(Section::UserWords, users);
+    header.searches = writeSection(Section::SearchHistory, searches);
+    header.crc = headerCrc(header);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    out.close();
+    if (!out || !replaceDurably(temp, path)) {
+        LOG_ERROR << "Cannot save user history to " << path;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool HistoryFile::writeText(const string& path, const PersistentCountMap& users,
+                            const PersistentCountMap& searches, uint64_t checkpoint) {
+    string temp = path + ".tmp";
+    std::ofstream out(temp);
+    if (!out) {
+        LOG_ERROR << "Cannot save user history to " << path;
+        return false;
+    }
+    
+    // Log records up to this LSN are already counted below
+    if (checkpoint > 0) {
+        out << "[CHECKPOINT] " << checkpoint << "\n";
+    }
+    auto writeSection = [&out](const PersistentCountMap& counts) {
+        counts.forEach([&out](const string& word, int count) {
+            out << word << " " << count << "\n";
+        });
+    };
+    out << "[USER_WORDS]\n";
+    writeSection(users);
+    out << "[SEARCH_HISTORY]\n";
+    writeSection(searches);
+    
+    out.close();
+    if (!out || !replaceDurably(temp, path)) {
+        LOG_ERROR << "Cannot save user history to " << path;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool HistoryFile::read(const string& path, uint64_t& checkpoint, const Sink& sink) {
+    MappedFile file;
+    if (!file.open(path)) {
+        LOG_ERROR << "Cannot open history " << path;
+        return false;
+    }
+    checkpoint = 0;
+    string_view data = file.text();
+    if (data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0) {
+        return readBinary(data, checkpoint, sink, path);
+    }
+    return readText(data, checkpoint, sink);
+}
+
+bool HistoryFile::convert(const string& from, const string& to, bool text) {
+    vector<pair<string, int>> entries[2];
+    uint64_t checkpoint = 0;
+    bool valid = read(from, checkpoint, [&entries](Section section, string_view word, int count) {
+        entries[int(section)].emplace_back(string(word), count);
+    });
+    if (!valid) return false;
+    
+    // Each word comes once per section, so the counts are the deltas from empty
+    HistorySnapshot empty;
+    std::unique_ptr<HistorySnapshot> history(empty.withUpdates(entries[0], entries[1]));
+    return text ? writeText(to, history->user, history->search, checkpoint)
+                : write(to, history->user, history->search, checkpoint);
+}
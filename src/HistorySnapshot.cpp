@@ -0,0 +1,19 @@
+#include "HistorySnapshot.h"
+
+int HistorySnapshot::userCount(const string& word) const {
+    return user.find(word);
+}
+
+int HistorySnapshot::searchCount(const string& query) const {
+    return search.find(query);
+}
+
+HistorySnapshot* HistorySnapshot::withUpdates(const vector<pair<string, int>>& userDeltas,
+                                              const vector<pair<string, int>>& searchDeltas) const {
+    auto* next = new HistorySnapshot();
+    next->user = user.withDeltas(userDeltas);
+    next->search = search.withDeltas(searchDeltas);
+    next->userSize = next->user.size();
+    next->searchSize = next->search.size();
+    return next;
+}
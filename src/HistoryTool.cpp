@@ -0,0 +1,20 @@
+// Converts user-history snapshots between the binary format the server
+// writes and the text format (see HistoryFile.h), for inspection, hand
+// edits and importing old snapshots.
+// Usage: history_tool export <history file> <text file>
+//        history_tool import <text file> <history file>
+#include "HistoryFile.h"
+#include <iostream>
+
+int main(int argc, char** argv) {
+    string mode = argc == 4 ? argv[1] : "";
+    if (mode != "export" && mode != "import") {
+        std::cerr << "Usage: " << argv[0] << " export <history file> <text file>\n"
+                  << "       " << argv[0] << " import <text file> <history file>\n";
+        return 2;
+    }
+    
+    if (!HistoryFile::convert(argv[2], argv[3], mode == "export")) return 1;
+    std::cout << (mode == "export" ? "Exported " : "Imported ") << argv[2] << " to " << argv[3] << "\n";
+    return 0;
+}
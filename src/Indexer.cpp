@@ -0,0 +1,34 @@
+// Offline dictionary indexer: builds the trie from a word list once and
+// writes the binary index (see TrieIndex.h) the server maps at startup.
+// Usage: indexer <word list> <index file>
+#include "DictionaryLoader.h"
+#include "MappedFile.h"
+#include "TrieIndex.h"
+#include <iostream>
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <word list> <index file>\n";
+        return 2;
+    }
+    
+    MappedFile file;
+    if (!file.open(argv[1])) {
+        std::cerr << "Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    int lines = 0;
+    TrieNode* root = DictionaryLoader::buildSorted(file.text(), lines);
+    if (!root) {
+        root = new TrieNode();
+        lines = DictionaryLoader::loadLines(root, file.text());
+    }
+    
+    bool written = TrieIndex::write(root, argv[2]);
+    if (written) {
+        std::cout << "Indexed " << root->wordCount << " words from " << lines
+                  << " lines into " << argv[2] << "\n";
+    }
+    TrieNode::destroyTree(root);
+    return written ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram() : counts(new std::atomic<uint64_t>[kBuckets]) {
+    for (size_t i = 0; i < kBuckets; ++i) counts[i].store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::lowestIn(size_t bucket) {
+    constexpr size_t linear = size_t(2) << kSubBucketBits;
+    if (bucket < linear) return bucket;
+    int shift = int(bucket >> kSubBucketBits) - 1;
+    uint64_t sub = (bucket & ((size_t(1) << kSubBucketBits) - 1)) | (size_t(1) << kSubBucketBits);
+    return sub << shift;
+}
+
+uint64_t LatencyHistogram::highestIn(size_t bucket) {
+    if (bucket + 1 >= kBuckets) return (uint64_t(1) << kMaxBits) - 1;
+    return lowestIn(bucket + 1) - 1;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snap;
+    snap.counts.resize(kBuckets);
+    for (size_t i = 0; i < kBuckets; ++i) {
+        snap.counts[i] = counts[i].load(std::memory_order_relaxed);
+        snap.total += snap.counts[i];
+    }
+    snap.sumNs = sumNs.load(std::memory_order_relaxed);
+    return snap;
+}
+
+uint64_t LatencyHistogram::Snapshot::quantile(double q) const {
+    if (total == 0) return 0;
+    // The rank of the quantile among the recorded values, counted from 1
+    uint64_t rank = uint64_t(q * double(total) + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) return highestIn(i);
+    }
+    return highestIn(counts.size() - 1);
+}
@@ -0,0 +1,379 @@
+#include "Log.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+std::atomic<int> Log::threshold{int(LogLevel::Info)};
+
+namespace {
+
+// Padded like crow's own records, so the two line up in one log
+const char* const kLevelNames[] = {"DEBUG   ", "INFO    ", "WARNING ", "ERROR   "};
+
+constexpr size_t kRingBytes = 64 << 10;   // per logging thread, a power of two
+constexpr uint32_t kWrapMarker = UINT32_MAX;
+// While records keep coming the writer drains every millisecond, so one
+// write carries many lines; once the rings are empty it sleeps until a
+// producer wakes it, or this long as a backstop
+constexpr auto kBatchPause = std::chrono::milliseconds(1);
+constexpr auto kIdleBackstop = std::chrono::seconds(1);
+
+// What precedes a record's arguments in the ring; records start 8-aligned
+struct RecordHeader {
+    uint32_t size;   // header plus arguments, before alignment
+    uint8_t level;
+    uint8_t truncated;
+    uint8_t channel;
+    uint8_t reserved;
+    int64_t timeNs;
+};
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+// Single producer (the owning thread), single consumer (whoever holds
+// drainMutex). Positions only grow; the byte offset is position % size.
+struct Ring {
+    alignas(64) std::atomic<uint64_t> head{0};   // written by the producer
+    alignas(64) std::atomic<uint64_t> tail{0};   // written by the consumer
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> closed{false};             // the thread has exited
+    uint64_t droppedReported = 0;                // consumer only
+    char bytes[kRingBytes];
+};
+
+struct Logger {
+    std::mutex registryMutex;
+    std::vector<Ring*> rings;
+    std::mutex drainMutex;
+    std::atomic<int> fds[Log::kChannels] = {STDERR_FILENO, -1, -1, -1};
+    std::mutex channelsMutex;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> written{0};
+
+    // An idle writer waits on `wake`; see Log::submit for how a producer
+    // and the writer going to sleep cannot miss each other
+    std::atomic<bool> writerAsleep{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool woken = false;
+
+    // The writer's formatting state, under drainMutex; one buffer per channel
+    std::string outs[Log::kChannels];
+    time_t stampSecond = -1;
+    char stamp[32];
+    size_t stampSize = 0;
+
+    Logger() {
+        std::thread([this] {
+            for (;;) {
+                if (drain()) {
+                    std::this_thread::sleep_for(kBatchPause);
+                    continue;
+                }
+                writerAsleep.store(true);
+                if (pending()) {
+                    writerAsleep.store(false);
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait_for(lock, kIdleBackstop, [this] { return woken; });
+                woken = false;
+                writerAsleep.store(false);
+            }
+        }).detach();
+        std::atexit([] { Log::flush(); });
+    }
+
+    bool drain();
+    bool pending();
+    void wakeWriter();
+    void prefix(std::string& out, int level, int64_t timeNs);
+    void format(const RecordHeader& header, const char* args);
+    void emit(int channel);
+};
+
+// Never destroyed: the writer thread and threads still logging during
+// static destruction keep using it
+Logger& logger() {
+    static Logger* instance = new Logger();
+    return *instance;
+}
+
+// The calling thread's ring, registered on first use and handed back to
+// the writer (which frees it once drained) when the thread exits
+struct RingHandle {
+    Ring* ring = nullptr;
+
+    Ring* get() {
+        if (!ring) {
+            ring = new Ring();
+            Logger& log = logger();
+            std::lock_guard<std::mutex> lock(log.registryMutex);
+            log.rings.push_back(ring);
+        }
+        return ring;
+    }
+
+    ~RingHandle() {
+        if (ring) ring->closed.store(true, std::memory_order_release);
+        ring = nullptr;   // the writer owns it now
+    }
+};
+
+thread_local RingHandle threadRing;
+
+void Logger::prefix(std::string& out, int level, int64_t timeNs) {
+    time_t second = time_t(timeNs / 1000000000);
+    if (second != stampSecond) {
+        tm utc;
+        gmtime_r(&second, &utc);
+        stampSize = strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &utc);
+        stampSecond = second;
+    }
+    out += '(';
+    out.append(stamp, stampSize);
+    out += ") [";
+    out += kLevelNames[std::min(level, int(LogLevel::Error))];
+    out += "] ";
+}
+
+void Logger::format(const RecordHeader& header, const char* args) {
+    std::string& out = outs[header.channel];
+    prefix(out, header.level, header.timeNs);
+    const char* end = args + (header.size - sizeof(RecordHeader));
+    size_t lineStart = out.size();
+    char digits[32];
+    while (args < end) {
+        char tag = *args++;
+        switch (tag) {
+        case LogLine::Text: {
+            uint16_t length;
+            std::memcpy(&length, args, sizeof(length));
+            out.append(args + sizeof(length), length);
+            args += sizeof(length) + length;
+            break;
+        }
+        case LogLine::Signed: {
+            int64_t value;
+            std::memcpy(&value, args, sizeof(value));
+            out.append(digits, snprintf(digits, sizeof(digits), "%lld", (long long)value));
+            args += sizeof(value);
+            break;
+        }
+        case LogLine::Unsigned: {
+            uint64_t value;
+            std::memcpy(&value, args, sizeof(value));
+            out.append(digits, snprintf(digits, sizeof(digits), "%llu", (unsigned long long)value));
+            args += sizeof(value);
+            break;
+        }
+        case LogLine::Real: {
+            double value;
+            std::memcpy(&value, args, sizeof(value));
+            out.append(digits, snprintf(digits, sizeof(digits), "%g", value));
+            args += sizeof(value);
+            break;
+        }
+        case LogLine::Char:
+            out += *args++;
+            break;
+        default:
+            args = end;   // cannot happen: only LogLine writes records
+            break;
+        }
+    }
+    if (header.truncated) out += " [truncated]";
+    if (out.size() == lineStart || out.back() != '\n') out += '\n';
+    written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::emit(int channel) {
+    std::string& out = outs[channel];
+    int target = fds[channel].load();
+    for (size_t done = 0; done < out.size();) {
+        ssize_t n = ::write(target, out.data() + done, out.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    out.clear();
+}
+
+bool Logger::pending() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (Ring* ring : rings) {
+        if (ring->head.load() != ring->tail.load(std::memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
+void Logger::wakeWriter() {
+    // Only the producer that clears the flag signals; the rest find it clear
+    if (!writerAsleep.load() || !writerAsleep.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        woken = true;
+    }
+    wake.notify_one();
+}
+
+bool Logger::drain() {
+    std::lock_guard<std::mutex> drainLock(drainMutex);
+    std::vector<Ring*> current;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        current = rings;
+    }
+
+    bool busy = false;
+    for (Ring* ring : current) {
+        // Read closed first: a ring closed by then has no more records coming
+        bool closed = ring->closed.load(std::memory_order_acquire);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        while (tail < head) {
+            size_t offset = tail % kRingBytes;
+            RecordHeader header;
+            std::memcpy(&header.size, ring->bytes + offset, sizeof(header.size));
+            if (header.size == kWrapMarker) {
+                tail += kRingBytes - offset;
+                continue;
+            }
+            std::memcpy(&header, ring->bytes + offset, sizeof(header));
+            format(header, ring->bytes + offset + sizeof(header));
+            tail += align8(header.size);
+            if (outs[header.channel].size() >= (64 << 10)) emit(header.channel);
+            busy = true;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        uint64_t droppedNow = ring->dropped.load(std::memory_order_relaxed);
+        if (droppedNow != ring->droppedReported) {
+            uint64_t lost = droppedNow - ring->droppedReported;
+            ring->droppedReported = droppedNow;
+            dropped.fetch_add(lost, std::memory_order_relaxed);
+
+            prefix(outs[0], int(LogLevel::Warn), std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+            outs[0] += "Log buffer full; dropped " + std::to_string(lost) + " records\n";
+        }
+
+        if (closed) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            rings.erase(std::find(rings.begin(), rings.end(), ring));
+            delete ring;
+        }
+    }
+    for (int channel = 0; channel < Log::kChannels; ++channel) {
+        if (!outs[channel].empty()) emit(channel);
+    }
+    return busy;
+}
+
+} // namespace
+
+LogLine::LogLine(LogLevel level, int channel)
+    : level(level),
+      channel(uint8_t(channel >= 0 && channel < Log::kChannels ? channel : 0)),
+      timeNs(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count()) {}
+
+LogLine& LogLine::operator<<(std::string_view text) {
+    size_t room = used + 1 + sizeof(uint16_t) < kMaxBytes ? kMaxBytes - used - 1 - sizeof(uint16_t) : 0;
+    if (room == 0) {
+        truncated = true;
+        return *this;
+    }
+    if (text.size() > room) {
+        text = text.substr(0, room);
+        truncated = true;
+    }
+    uint16_t length = (uint16_t)text.size();
+    data[used] = Text;
+    std::memcpy(data + used + 1, &length, sizeof(length));
+    std::memcpy(data + used + 1 + sizeof(length), text.data(), text.size());
+    used += 1 + sizeof(length) + text.size();
+    return *this;
+}
+
+bool Log::parseLevel(std::string_view name, LogLevel& level) {
+    const std::string_view names[] = {"debug", "info", "warn", "error", "off"};
+    for (int i = 0; i <= int(LogLevel::Off); ++i) {
+        if (name == names[i]) {
+            level = LogLevel(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Log::setOutput(int fd) {
+    logger().fds[0].store(fd);
+}
+
+int Log::addOutput(int fd) {
+    Logger& log = logger();
+    std::lock_guard<std::mutex> lock(log.channelsMutex);
+    for (int channel = 1; channel < kChannels; ++channel) {
+        if (log.fds[channel].load() < 0) {
+            log.fds[channel].store(fd);
+            return channel;
+        }
+    }
+    return -1;
+}
+
+void Log::flush() {
+    logger().drain();
+}
+
+uint64_t Log::dropped() {
+    return logger().dropped.load();
+}
+
+uint64_t Log::written() {
+    return logger().written.load();
+}
+
+void Log::submit(const LogLine& line) {
+    Ring* ring = threadRing.get();
+    RecordHeader header;
+    header.size = uint32_t(sizeof(header) + line.used);
+    header.level = uint8_t(line.level);
+    header.truncated = line.truncated;
+    header.channel = line.channel;
+    header.reserved = 0;
+    header.timeNs = line.timeNs;
+
+    // Records never straddle the end of the ring: if one does not fit
+    // before it, a marker sends the reader back to the start
+    size_t need = align8(header.size);
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    size_t offset = head % kRingBytes;
+    size_t skip = kRingBytes - offset < need ? kRingBytes - offset : 0;
+    if (head + skip + need - tail > kRingBytes) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (skip) {
+        std::memcpy(ring->bytes + offset, &kWrapMarker, sizeof(kWrapMarker));
+        head += skip;
+        offset = 0;
+    }
+    std::memcpy(ring->bytes + offset, &header, sizeof(header));
+    std::memcpy(ring->bytes + offset + sizeof(header), line.data, line.used);
+    // Sequentially consistent, like the writer's store of writerAsleep and
+    // its loads of every head in pending(): either the writer sees this
+    // record before it sleeps or this thread sees it asleep and wakes it
+    ring->head.store(head + need);
+    logger().wakeWriter();
+}
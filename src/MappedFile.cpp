@@ -0,0 +1,38 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    if (data) ::munmap(data, size);
+}
+
+bool MappedFile::open(const string& path) {
+    if (data) ::munmap(data, size);
+    data = nullptr;
+    size = 0;
+    
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        // mmap rejects empty lengths
+        ::close(fd);
+        return true;
+    }
+    
+    void* mapped = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);   // the mapping keeps its own reference
+    if (mapped == MAP_FAILED) return false;
+    ::madvise(mapped, (size_t)st.st_size, MADV_SEQUENTIAL);
+    
+    data = mapped;
+    size = (size_t)st.st_size;
+    return true;
+}
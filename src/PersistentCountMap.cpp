@@ -0,0 +1,154 @@
+#include "PersistentCountMap.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// The hash has room for this many levels; a leaf this deep holds keys whose
+// hashes agree in every bit used so far and may grow past kLeafCapacity
+constexpr int kMaxLevel = 64 / PersistentCountMap::kBits;
+
+uint64_t hashOf(const string& key) {
+    return std::hash<string>{}(key);
+}
+
+} // namespace
+
+struct PersistentCountMap::Delta {
+    uint64_t hash;
+    const pair<string, int>* delta;
+};
+
+size_t PersistentCountMap::slot(uint64_t hash, int level) {
+    // From the top bits down, so entries sorted by hash are also grouped by
+    // child at every level
+    return size_t(hash >> (64 - kBits * (level + 1))) & (kFanout - 1);
+}
+
+int PersistentCountMap::find(const string& key) const {
+    uint64_t hash = hashOf(key);
+    const Node* node = root.get();
+    for (int level = 0; node && !node->children.empty(); ++level) {
+        node = node->children[slot(hash, level)].get();
+    }
+    if (!node) return 0;
+    auto it = std::lower_bound(node->entries.begin(), node->entries.end(), hash,
+                               [](const Entry& entry, uint64_t h) { return entry.hash < h; });
+    for (; it != node->entries.end() && it->hash == hash; ++it) {
+        if (it->key == key) return it->count;
+    }
+    return 0;
+}
+
+PersistentCountMap PersistentCountMap::withDeltas(const vector<pair<string, int>>& deltas) const {
+    if (deltas.empty()) return *this;
+    vector<Delta> sorted;
+    sorted.reserve(deltas.size());
+    for (const auto& delta : deltas) sorted.push_back({hashOf(delta.first), &delta});
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Delta& a, const Delta& b) { return a.hash < b.hash; });
+
+    PersistentCountMap next;
+    size_t added = 0;
+    next.root = update(root, sorted.data(), sorted.data() + sorted.size(), 0, added);
+    next.count = count + added;
+    return next;
+}
+
+std::shared_ptr<PersistentCountMap::Node> PersistentCountMap::split(const Node& leaf, int level) {
+    auto inner = std::make_shared<Node>();
+    inner->children.resize(kFanout);
+    std::shared_ptr<Node> child;
+    size_t childSlot = kFanout;
+    for (const Entry& entry : leaf.entries) {
+        size_t s = slot(entry.hash, level);
+        if (s != childSlot) {
+            child = std::make_shared<Node>();
+            inner->children[s] = child;
+            childSlot = s;
+        }
+        child->entries.push_back(entry);
+    }
+    return inner;
+}
+
+PersistentCountMap::NodePtr PersistentCountMap::update(const NodePtr& node, const Delta* begin,
+                                                       const Delta* end, int level, size_t& added) {
+    static const Node empty;
+    const Node& current = node ? *node : empty;
+    std::shared_ptr<Node> copy;
+    if (!current.children.empty()) {
+        copy = std::make_shared<Node>(current);
+    } else if (level < kMaxLevel && current.entries.size() + size_t(end - begin) > kLeafCapacity) {
+        // More than one leaf holds: branch here and pass each child its share
+        copy = split(current, level);
+    } else {
+        copy = std::make_shared<Node>(current);
+        vector<Entry>& entries = copy->entries;
+        for (const Delta* d = begin; d != end; ++d) {
+            auto it = std::lower_bound(entries.begin(), entries.end(), d->hash,
+                                       [](const Entry& entry, uint64_t h) { return entry.hash < h; });
+            while (it != entries.end() && it->hash == d->hash && it->key != d->delta->first) ++it;
+            if (it != entries.end() && it->hash == d->hash && it->key == d->delta->first) {
+                it->count += d->delta->second;
+            } else {
+                entries.insert(it, Entry{d->hash, d->delta->first, d->delta->second});
+                added++;
+            }
+        }
+        return copy;
+    }
+
+    // The deltas are sorted by hash, so each child's share is one run
+    for (const Delta* run = begin; run != end;) {
+        size_t s = slot(run->hash, level);
+        const Delta* runEnd = run;
+        while (runEnd != end && slot(runEnd->hash, level) == s) ++runEnd;
+        copy->children[s] = update(copy->children[s], run, runEnd, level + 1, added);
+        run = runEnd;
+    }
+    return copy;
+}
+
+HistoryMemoryStats PersistentCountMap::memoryStats() const {
+    // make_shared puts each node beside its reference counts; a key longer
+    // than the small-string buffer adds its own allocation
+    const size_t nodeBytes = sizeof(Node) + sizeof(void*) + 2 * sizeof(int);
+    const size_t inlineCapacity = string().capacity();
+
+    HistoryMemoryStats stats;
+    vector<const Node*> pending;
+    if (root) pending.push_back(root.get());
+    while (!pending.empty()) {
+        const Node* node = pending.back();
+        pending.pop_back();
+        stats.nodes++;
+        stats.bytes += nodeBytes + node->children.capacity() * sizeof(NodePtr) +
+                       node->entries.capacity() * sizeof(Entry);
+        for (const Entry& entry : node->entries) {
+            stats.entries++;
+            stats.keyBytes += entry.key.size();
+            if (entry.key.capacity() > inlineCapacity) stats.bytes += entry.key.capacity() + 1;
+        }
+        for (const NodePtr& child : node->children) {
+            if (child) pending.push_back(child.get());
+        }
+    }
+    return stats;
+}
+
+size_t PersistentCountMap::entriesNotSharedWith(const PersistentCountMap& base) const {
+    size_t entries = 0;
+    vector<pair<const Node*, const Node*>> pending{{root.get(), base.root.get()}};
+    while (!pending.empty()) {
+        auto [node, old] = pending.back();
+        pending.pop_back();
+        if (!node || node == old) continue;
+        entries += node->entries.size();
+        for (size_t i = 0; i < node->children.size(); ++i) {
+            const Node* oldChild = old && !old->children.empty() ? old->children[i].get() : nullptr;
+            pending.emplace_back(node->children[i].get(), oldChild);
+        }
+    }
+    return entries;
+}
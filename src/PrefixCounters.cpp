@@ -0,0 +1,71 @@
+#include "PrefixCounters.h"
+#include <utility>
+
+namespace {
+
+std::atomic<uint64_t> nextId{1};
+
+} // namespace
+
+PrefixCounters::PrefixCounters(size_t localLimit)
+    : id(nextId.fetch_add(1)), localLimit(localLimit) {}
+
+PrefixCounters::Slot& PrefixCounters::local() {
+    // Instance ids are never reused, so entries left behind by a destroyed
+    // instance are simply never matched again.
+    thread_local vector<std::pair<uint64_t, Slot*>> cache;
+    for (const auto& entry : cache) {
+        if (entry.first == id) return *entry.second;
+    }
+    
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    slots.push_back(std::make_unique<Slot>());
+    cache.emplace_back(id, slots.back().get());
+    return *slots.back();
+}
+
+size_t PrefixCounters::add(const string& key) {
+    Slot& slot = local();
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    ++slot.counts[key];
+    return slot.counts.size();
+}
+
+int PrefixCounters::pending(const string& key) const {
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    int total = 0;
+    for (const auto& slot : slots) {
+        std::lock_guard<std::mutex> slotLock(slot->mutex);
+        auto it = slot->counts.find(key);
+        if (it != slot->counts.end()) total += it->second;
+    }
+    return total;
+}
+
+size_t PrefixCounters::pendingKeys() const {
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    size_t total = 0;
+    for (const auto& slot : slots) {
+        std::lock_guard<std::mutex> slotLock(slot->mutex);
+        total += slot->counts.size();
+    }
+    return total;
+}
+
+PrefixCounters::CountMap PrefixCounters::drain() {
+    CountMap merged;
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (const auto& slot : slots) {
+        CountMap taken;
+        {
+            std::lock_guard<std::mutex> slotLock(slot->mutex);
+            taken.swap(slot->counts);
+        }
+        if (merged.empty()) {
+            merged.swap(taken);
+            continue;
+        }
+        for (const auto& entry : taken) merged[entry.first] += entry.second;
+    }
+    return merged;
+}
@@ -0,0 +1,21 @@
+#include "Probes.h"
+
+#if PROBES_ACTIVE
+
+// Tracers find these through the probe notes and increment them while
+// attached; the section name is the one <sys/sdt.h> uses
+#define PROBE_DEFINE_SEMAPHORE(name) \
+    __attribute__((section(".probes"))) volatile unsigned short PROBE_SEMAPHORE(name) = 0
+
+extern "C" {
+PROBE_DEFINE_SEMAPHORE(request__start);
+PROBE_DEFINE_SEMAPHORE(request__done);
+PROBE_DEFINE_SEMAPHORE(query__start);
+PROBE_DEFINE_SEMAPHORE(query__done);
+PROBE_DEFINE_SEMAPHORE(collect__start);
+PROBE_DEFINE_SEMAPHORE(collect__done);
+PROBE_DEFINE_SEMAPHORE(history__save__start);
+PROBE_DEFINE_SEMAPHORE(history__save__done);
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "RequestMetrics.h"
+#include <cstdio>
+
+RequestMetrics::RequestMetrics(vector<string> names) {
+    names.push_back("other");
+    for (string& name : names) {
+        routes.emplace_back(new Route());
+        routes.back()->name = std::move(name);
+    }
+}
+
+size_t RequestMetrics::route(std::string_view path) const {
+    for (size_t i = 0; i + 1 < routes.size(); ++i) {
+        if (routes[i]->name == path) return i;
+    }
+    return routes.size() - 1;
+}
+
+void RequestMetrics::record(size_t route, int status, uint64_t ns) {
+    routes[route]->latency.record(ns);
+    record(route, status);
+}
+
+void RequestMetrics::record(size_t route, int status) {
+    if (status < kLowestStatus || status >= kLowestStatus + kStatuses) status = 500;
+    routes[route]->statuses[status - kLowestStatus].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Durations are exported in seconds, as Prometheus expects
+static void appendSeconds(string& out, uint64_t ns) {
+    char text[32];
+    out.append(text, snprintf(text, sizeof(text), "%.9g", double(ns) / 1e9));
+}
+
+string RequestMetrics::prometheus() const {
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    const char* const quantileLabels[] = {"0.5", "0.9", "0.99", "0.999"};
+
+    string out;
+    out += "# HELP autocomplete_request_duration_seconds Time from routing a request to its response.\n";
+    out += "# TYPE autocomplete_request_duration_seconds summary\n";
+    for (const auto& slot : routes) {
+        LatencyHistogram::Snapshot snap = slot->latency.snapshot();
+        string labels = "route=\"" + slot->name + "\"";
+        for (size_t q = 0; q < 4; ++q) {
+            out += "autocomplete_request_duration_seconds{" + labels + ",quantile=\"" +
+                   quantileLabels[q] + "\"} ";
+            if (snap.total == 0) out += "NaN";
+            else appendSeconds(out, snap.quantile(quantiles[q]));
+            out += '\n';
+        }
+        out += "autocomplete_request_duration_seconds_sum{" + labels + "} ";
+        appendSeconds(out, snap.sumNs);
+        out += "\nautocomplete_request_duration_seconds_count{" + labels + "} " +
+               std::to_string(snap.total) + "\n";
+    }
+
+    out += "# HELP autocomplete_requests_total Requests answered, by route and status code.\n";
+    out += "# TYPE autocomplete_requests_total counter\n";
+    for (const auto& slot : routes) {
+        for (int i = 0; i < kStatuses; ++i) {
+            uint64_t count = slot->statuses[i].load(std::memory_order_relaxed);
+            if (count == 0) continue;
+            out += "autocomplete_requests_total{route=\"" + slot->name + "\",code=\"" +
+                   std::to_string(kLowestStatus + i) + "\"} " + std::to_string(count) + "\n";
+        }
+    }
+    return out;
+}
@@ -0,0 +1,70 @@
+#include "SlowQueryLog.h"
+#include "Log.h"
+#include <chrono>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+SlowQueryLog::SlowQueryLog(int64_t thresholdNs, size_t capacity)
+    : thresholdNs(thresholdNs), capacity(capacity) {}
+
+bool SlowQueryLog::open(const string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    channel = Log::addOutput(fd);
+    if (channel < 0) {
+        ::close(fd);
+        return false;
+    }
+    return true;
+}
+
+bool SlowQueryLog::sampleTrace() const {
+    if (!enabled()) return false;
+    // Per thread, so sampling shares no cache line between workers
+    thread_local unsigned requests = 0;
+    return requests++ % kTraceEvery == 0;
+}
+
+void SlowQueryLog::offer(const string& prefix, int64_t totalNs, const QueryTrace& trace,
+                         bool traced) {
+    if (!enabled() || totalNs < thresholdNs) return;
+
+    SlowQuery query;
+    query.unixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    query.prefix = prefix;
+    query.totalNs = totalNs;
+    query.traced = traced;
+    query.trace = trace;
+    query.threadId = uint64_t(syscall(SYS_gettid));
+
+    if (channel >= 0) {
+        LogLine(LogLevel::Warn, channel)
+            << "slow query prefix='" << prefix << "' request_ns=" << totalNs
+            << " user_candidates=" << trace.userCandidates
+            << " dict_candidates=" << trace.dictCandidates
+            << " user_nodes=" << trace.user.nodesVisited
+            << " dict_nodes=" << trace.dict.nodesVisited
+            << " heap_ops=" << trace.user.heapPushes + trace.user.heapPops +
+                                  trace.dict.heapPushes + trace.dict.heapPops
+            << " dict_parallel=" << trace.dict.parallel
+            << (traced ? " traced" : " untraced") << " thread=" << query.threadId;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    total++;
+    if (capacity == 0) return;
+    if (queries.size() == capacity) queries.pop_front();
+    queries.push_back(std::move(query));
+}
+
+vector<SlowQuery> SlowQueryLog::recent() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return vector<SlowQuery>(queries.begin(), queries.end());
+}
+
+uint64_t SlowQueryLog::recorded() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total;
+}
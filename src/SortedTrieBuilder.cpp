@@ -0,0 +1,44 @@
+#include "SortedTrieBuilder.h"
+#include <algorithm>
+
+SortedTrieBuilder::SortedTrieBuilder(size_t nodes)
+    : block(TrieNode::allocateBlock(std::max<size_t>(nodes, 1))),
+      capacity(std::max<size_t>(nodes, 1)),
+      path{block} {}
+
+SortedTrieBuilder::~SortedTrieBuilder() {
+    TrieNode::destroyTree(block);
+}
+
+bool SortedTrieBuilder::add(std::string_view word, int count) {
+    size_t shared = 0;
+    size_t limit = std::min(prev.size(), word.size());
+    while (shared < limit && prev[shared] == word[shared]) shared++;
+    if (shared < word.size() ? (shared < prev.size() && word[shared] < prev[shared])
+                             : word.size() < prev.size()) {
+        return false;
+    }
+    if (used + (word.size() - shared) > capacity) return false;
+    
+    path.resize(shared + 1);
+    for (size_t d = shared; d < word.size(); ++d) {
+        TrieNode* node = &block[used++];
+        path.back()->children[word[d] - 'a'].store(node, std::memory_order_relaxed);
+        path.push_back(node);
+    }
+    prev.assign(word.data(), word.size());
+    if (count <= 0) return true;   // same as TrieNode::insert
+    
+    TrieNode* end = path.back();
+    end->frequency.fetch_add(count, std::memory_order_relaxed);
+    if (!end->isEndOfWord.exchange(true, std::memory_order_relaxed)) {
+        for (TrieNode* node : path) node->wordCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+TrieNode* SortedTrieBuilder::finish() {
+    TrieNode* root = block;
+    block = nullptr;
+    return root;
+}
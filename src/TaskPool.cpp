@@ -0,0 +1,80 @@
+#include "TaskPool.h"
+
+TaskPool::TaskPool(unsigned threads) {
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(&TaskPool::workerLoop, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers) w.join();
+}
+
+void TaskPool::runAll(vector<std::function<void()>>& tasks) {
+    if (tasks.empty()) return;
+    
+    std::atomic<size_t> remaining{tasks.size()};
+    for (auto& task : tasks) {
+        Queue& q = *queues[nextQueue++ % queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.emplace_back([&task, &remaining] {
+            task();
+            remaining.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    queued.fetch_add((long)tasks.size());
+    {
+        // Sleepers test `queued` under this mutex: taking it here means none
+        // of them can miss the notification between its test and its wait
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    
+    // Help instead of waiting; the caller is not a worker, so steal only
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (!runOne((unsigned)queues.size())) std::this_thread::yield();
+    }
+}
+
+bool TaskPool::runOne(unsigned self) {
+    std::function<void()> task;
+    unsigned n = (unsigned)queues.size();
+    if (self < n) {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (unsigned i = 1; !task && i <= n; ++i) {
+        Queue& victim = *queues[(self + i) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+void TaskPool::workerLoop(unsigned self) {
+    for (;;) {
+        if (runOne(self)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&] { return stopping || queued.load() > 0; });
+        if (stopping) return;
+    }
+}
@@ -1,113 +1,628 @@
 #include "Trie.h"
+#include "Epoch.h"
+#include "DictionaryLoader.h"
+#include "FrontCodedFile.h"
+#include "HistoryFile.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Probes.h"
+#include "TrieIndex.h"
+#include "WordIterator.h"
 #include <fstream>
-#include <iostream>
 #include <algorithm>
-#include <sstream>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
 
-Trie::Trie() : root(std::make_unique<TrieNode>()),
-               userRoot(std::make_unique<TrieNode>()) {}
+namespace {
 
-void Trie::insert(const string& word) {
-    root->insert(word);
+// Slots in the ingestion ring; a full ring drops new events
+constexpr size_t kQueueCapacity = 1 << 16;
+// Most events the aggregator applies under one writer critical section
+constexpr size_t kMaxBatch = 4096;
+// How soon an idle aggregator retries freeing retired objects that a
+// reader still pinned
+constexpr auto kReclaimRetry = std::chrono::milliseconds(10);
+// Default prefix merge policy, see Trie::setPrefixMerge
+constexpr auto kPrefixMergeInterval = std::chrono::milliseconds(100);
+constexpr size_t kPrefixLocalLimit = 1024;
+
+// What the aggregator is waiting for, in Trie::aggregatorSleep
+enum AggregatorSleep : int {
+    kAwake = 0,
+    kMergeScheduled = 1,   // asleep with a prefix merge due at a set time
+    kIdle = 2              // asleep until woken, or until a log sync is due
+};
+
+void retireTree(void* node) {
+    TrieNode::destroyTree(static_cast<TrieNode*>(node));
+}
+
+} // namespace
+
+Trie::Trie() : root(new TrieNode()),
+               userRoot(new TrieNode()),
+               history(new HistorySnapshot()),
+               events(kQueueCapacity),
+               prefixCounts(kPrefixLocalLimit),
+               prefixMergeIntervalMs(kPrefixMergeInterval.count()),
+               aggregator(&Trie::aggregatorLoop, this) {}
+
+Trie::~Trie() {
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        if (reloader.joinable()) reloader.join();
+    }
+    
+    // The aggregator applies (and logs) whatever is still queued first
+    stopping.store(true);
+    wakeAggregator();
+    {
+        // Taken so the snapshotter is either waiting or sees the flag
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+    }
+    snapshotWake.notify_all();
+    if (snapshotter.joinable()) snapshotter.join();
+    aggregator.join();
+    
+    TrieNode::destroyTree(root.load());
+    TrieNode::destroyTree(userRoot.load());
+    delete history.load();
+    delete wal.load();
+}
+
+void Trie::rebuildPublished(std::atomic<TrieNode*>& slot,
+                            const std::function<void(TrieNode*)>& fill) {
+    TrieNode* copy = TrieNode::cloneTree(slot.load());
+    fill(copy);
+    Epoch::retire(slot.exchange(copy), retireTree);
+}
+
+void Trie::updateHistory(const vector<pair<string, int>>& userDeltas,
+                         const vector<pair<string, int>>& searchDeltas) {
+    HistorySnapshot* current = history.load();
+    history.store(current->withUpdates(userDeltas, searchDeltas));
+    Epoch::retire(current);
+}
+
+void Trie::insert(const string& word, int count) {
+    // Only so a concurrent bulk load cannot drop the word from its copy
+    std::lock_guard<std::mutex> lock(writeMutex);
+    root.load()->insert(word, count);
 }
 
 void Trie::insertUserWord(const string& word) {
-    userRoot->insert(word);
-    userHistory[word]++;
+    userRoot.load()->insert(word);
+    
+    std::lock_guard<std::mutex> lock(writeMutex);
+    updateHistory({{word, 1}}, {});
 }
 
 bool Trie::search(const string& word) const {
-    return root->search(word);
+    EpochGuard guard;
+    return root.load()->search(word);
 }
 
 void Trie::recordSearchQuery(const string& query) {
     if (query.empty()) return;
     
-    // Track partial search queries
-    searchHistory[query]++;
-    
     // Insert into user trie for future suggestions
-    userRoot->insert(query);
+    userRoot.load()->insert(query);
     
-    std::cout << "Recorded search query: '" << query << "' (count: " << searchHistory[query] << ")\n";
+    int count;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        
+        // Track partial search queries
+        updateHistory({}, {{query, 1}});
+        count = history.load()->searchCount(query);
+    }
+    
+    LOG_DEBUG << "Recorded search query: '" << query << "' (count: " << count << ")";
 }
 
 void Trie::recordCompleteSearch(const string& query) {
     if (query.empty()) return;
     
-    // Give extra weight to complete searches
-    searchHistory[query] += 10;
-    userHistory[query] += 10;
-    
     // Insert into user trie
-    userRoot->insert(query);
+    userRoot.load()->insert(query);
+    
+    int count;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        
+        // Give extra weight to complete searches
+        updateHistory({{query, 10}}, {{query, 10}});
+        count = history.load()->searchCount(query);
+    }
+    
+    LOG_DEBUG << "Recorded complete search: '" << query << "' (total count: " << count << ")";
+}
+
+bool Trie::submitCompleteSearch(const string& query) {
+    if (query.empty()) return false;
+    return submit(IngestEvent::Kind::CompleteSearch, query);
+}
+
+bool Trie::submitUserWord(const string& word) {
+    return submit(IngestEvent::Kind::UserWord, word);
+}
+
+bool Trie::openHistoryLog(const string& snapshotFile, const string& walFile,
+                          const WalOptions& options) {
+    std::lock_guard<std::mutex> saveLock(saveMutex);
+    if (wal.load()) {
+        LOG_ERROR << "History log is already open";
+        return false;
+    }
+    // A damaged snapshot would be overwritten by the next compaction; keep
+    // it for inspection and run without a log instead
+    uint64_t checkpoint;
+    if (!loadHistoryFile(snapshotFile, checkpoint)) {
+        LOG_ERROR << "Not opening the history log over a damaged snapshot";
+        return false;
+    }
+    
+    // Replay what was logged after the snapshot: first a log sealed by a
+    // compaction that did not finish, then the live one
+    std::unordered_map<string, int> userDeltas;
+    std::unordered_map<string, int> searchDeltas;
+    vector<pair<string, int>> userWords;
+    size_t replayed = 0;
+    auto apply = [&](const WalRecord& record) {
+        int count = (int)record.count;
+        switch (record.op) {
+        case WalOp::CompleteSearch:
+            searchDeltas[record.text] += 10 * count;
+            userDeltas[record.text] += 10 * count;
+            userWords.emplace_back(record.text, count);
+            break;
+        case WalOp::UserWord:
+            userDeltas[record.text] += count;
+            userWords.emplace_back(record.text, count);
+            break;
+        case WalOp::PrefixHits:
+            searchDeltas[record.text] += count;
+            break;
+        }
+        replayed++;
+    };
+    uint64_t last = std::max(WriteAheadLog::replay(walFile + ".old", checkpoint, apply),
+                             WriteAheadLog::replay(walFile, checkpoint, apply));
+    
+    std::lock_guard<std::mutex> lock(writeMutex);
+    TrieNode* user = userRoot.load();
+    for (const auto& entry : userWords) {
+        user->insert(entry.first, entry.second);
+    }
+    updateHistory({userDeltas.begin(), userDeltas.end()},
+                  {searchDeltas.begin(), searchDeltas.end()});
+    
+    auto log = std::make_unique<WriteAheadLog>(options);
+    if (!log->open(walFile, last + 1)) return false;
+    snapshotPath = snapshotFile;
+    walPath = walFile;
+    compactedLsn.store(checkpoint);
+    wal.store(log.release());
+    snapshotter = std::thread(&Trie::snapshotLoop, this);
+    
+    LOG_INFO << "Replayed " << replayed << " history log records";
+    return true;
+}
+
+void Trie::compactHistoryLog() {
+    WriteAheadLog* log = wal.load();
+    if (!log) return;
+    
+    std::lock_guard<std::mutex> saveLock(saveMutex);
+    string sealed = walPath + ".old";
+    bool sealedLeft = std::ifstream(sealed).good();
+    PersistentCountMap users;
+    PersistentCountMap searches;
+    uint64_t checkpoint;
+    auto captureStart = std::chrono::steady_clock::now();
+    {
+        // Records are logged and published under writeMutex, so this history
+        // holds exactly the records up to the checkpoint. This section is the
+        // only pause a snapshot causes, and only for writers; readers never
+        // wait on it.
+        std::lock_guard<std::mutex> lock(writeMutex);
+        captureStart = std::chrono::steady_clock::now();
+        const HistorySnapshot* hist = history.load();
+        users = hist->user;
+        searches = hist->search;
+        // A sealed log left by a failed compaction is still needed until a
+        // snapshot covers it; keep appending to the live log instead
+        if (sealedLeft) {
+            checkpoint = log->lastLsn();
+        } else if (!log->rotate(sealed, checkpoint)) {
+            // The log still holds every record; try again next time
+            return;
+        }
+    }
+    auto writeStart = std::chrono::steady_clock::now();
+    int64_t pause = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        writeStart - captureStart).count();
+    lastSnapshotPauseNs.store(pause);
+    if (pause > maxSnapshotPauseNs.load()) maxSnapshotPauseNs.store(pause);
+    
+    // Written outside the lock; until the rename lands, the old snapshot
+    // plus the sealed log still reproduce the same state. write() returns
+    // once the new snapshot and its name are synced, and only then may the
+    // sealed log go.
+    if (!HistoryFile::write(snapshotPath, users, searches, checkpoint)) return;
+    std::remove(sealed.c_str());
+    
+    auto done = std::chrono::steady_clock::now();
+    lastSnapshotWriteNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        done - writeStart).count());
+    lastSnapshotAt.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        done.time_since_epoch()).count());
+    compactedLsn.store(checkpoint);
+    compactions.fetch_add(1);
+}
+
+void Trie::flushEvents() {
+    uint64_t target = events.pushed();
+    mergePrefixCounts();
+    std::unique_lock<std::mutex> lock(aggregatorMutex);
+    appliedWake.wait(lock, [this, target] { return applied.load() >= target; });
+}
+
+void Trie::setPrefixMerge(std::chrono::milliseconds interval, size_t localLimit) {
+    prefixMergeIntervalMs.store(interval.count());
+    prefixCounts.setLocalLimit(localLimit);
+}
+
+void Trie::setParallelCollection(int minSubtreeWords, unsigned threads) {
+    parallelThreshold = minSubtreeWords;
+    collectPool = minSubtreeWords > 0 ? std::make_unique<TaskPool>(threads) : nullptr;
+}
+
+int Trie::searchCount(const string& query) const {
+    EpochGuard guard;
+    return history.load()->searchCount(query) + prefixCounts.pending(query);
+}
+
+int Trie::userCount(const string& word) const {
+    EpochGuard guard;
+    return history.load()->userCount(word);
+}
+
+IngestStats Trie::ingestStats() const {
+    IngestStats stats;
+    stats.depth = events.depth();
+    stats.capacity = events.capacity();
+    stats.enqueued = events.pushed();
+    stats.applied = applied.load();
+    stats.dropped = dropped.load();
+    stats.batches = batches.load();
+    stats.lastApplyLagMs = lastApplyLagNs.load() / 1e6;
+    stats.maxApplyLagMs = maxApplyLagNs.load() / 1e6;
+    stats.prefixMerges = prefixMerges.load();
+    stats.pendingPrefixKeys = prefixCounts.pendingKeys();
+    WriteAheadLog* log = wal.load();
+    stats.walBytes = log ? log->bytes() : 0;
+    stats.walSyncs = log ? log->syncs() : 0;
+    stats.walFailedAppends = log ? log->failedAppends() : 0;
+    stats.walFailedSyncs = log ? log->failedSyncs() : 0;
+    stats.compactions = compactions.load();
+    stats.snapshotIntervalMs = log ? std::chrono::duration_cast<std::chrono::milliseconds>(
+        log->options().compactInterval).count() : 0;
+    int64_t snapshotAt = lastSnapshotAt.load();
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    stats.lastSnapshotAgeMs = snapshotAt ? (now - snapshotAt) / 1e6 : -1;
+    stats.lastSnapshotWriteMs = lastSnapshotWriteNs.load() / 1e6;
+    stats.lastSnapshotPauseMs = lastSnapshotPauseNs.load() / 1e6;
+    stats.maxSnapshotPauseMs = maxSnapshotPauseNs.load() / 1e6;
+    return stats;
+}
+
+bool Trie::submit(IngestEvent::Kind kind, const string& text) {
+    if (text.size() > kMaxTextBytes) return false;
+    if (events.tryPush({kind, text, std::chrono::steady_clock::now()})) {
+        wakeAggregator();
+        return true;
+    }
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Trie::wakeAggregator(bool prefixOnly) {
+    // A read-modify-write, like the aggregator's exchange before it sleeps:
+    // the two are ordered, so either the aggregator sees the work this
+    // thread published or this thread sees it going to sleep
+    int sleep = aggregatorSleep.fetch_add(0, std::memory_order_acq_rel);
+    if (sleep == kAwake || (prefixOnly && sleep == kMergeScheduled)) return;
+    {
+        std::lock_guard<std::mutex> lock(aggregatorMutex);
+        aggregatorWoken = true;
+    }
+    aggregatorWake.notify_one();
+}
+
+void Trie::aggregatorLoop() {
+    using Clock = std::chrono::steady_clock;
+    vector<IngestEvent> batch;
+    batch.reserve(kMaxBatch);
+    auto lastMerge = Clock::now();
+    for (;;) {
+        bool stop = stopping.load();
+        
+        auto now = Clock::now();
+        auto mergeInterval = std::chrono::milliseconds(prefixMergeIntervalMs.load());
+        if (stop || prefixMergeDue.load(std::memory_order_relaxed) ||
+            now - lastMerge >= mergeInterval) {
+            mergePrefixCounts();
+            lastMerge = now;
+        }
+        
+        batch.clear();
+        if (events.popBatch(batch, kMaxBatch) > 0) {
+            applyBatch(batch);
+            continue;
+        }
+        if (stop) break;   // stop was requested before the queue ran dry
+        WriteAheadLog* log = wal.load();
+        if (log) {
+            log->syncIfDue();
+            if (log->bytes() >= log->options().compactBytes) requestSnapshot();
+        }
+        Epoch::collect();
+        
+        // Nothing queued: sleep until woken or until the earliest timed
+        // chore (a prefix merge, a log sync, freeing retired objects). With
+        // none of those, an idle server's aggregator does not wake at all.
+        std::unique_lock<std::mutex> lock(aggregatorMutex);
+        aggregatorSleep.exchange(kIdle, std::memory_order_acq_rel);
+        Clock::time_point wakeAt = Clock::time_point::max();
+        if (prefixCounts.pendingKeys() > 0) {
+            aggregatorSleep.store(kMergeScheduled, std::memory_order_relaxed);
+            wakeAt = lastMerge + mergeInterval;
+        }
+        Clock::time_point syncAt;
+        if (log && log->syncPending(syncAt)) wakeAt = std::min(wakeAt, syncAt);
+        if (Epoch::pending() > 0) wakeAt = std::min(wakeAt, Clock::now() + kReclaimRetry);
+        
+        bool work = events.depth() > 0 || stopping.load() ||
+                    prefixMergeDue.load(std::memory_order_relaxed);
+        if (!work) {
+            if (wakeAt == Clock::time_point::max()) {
+                aggregatorWake.wait(lock, [this] { return aggregatorWoken; });
+            } else {
+                aggregatorWake.wait_until(lock, wakeAt, [this] { return aggregatorWoken; });
+            }
+        }
+        aggregatorWoken = false;
+        aggregatorSleep.store(kAwake, std::memory_order_relaxed);
+    }
+}
+
+void Trie::mergePrefixCounts() {
+    // Serialized so that flushEvents() also waits for a merge the aggregator
+    // has drained but not yet published
+    std::lock_guard<std::mutex> mergeLock(prefixMergeMutex);
+    prefixMergeDue.store(false, std::memory_order_relaxed);
+    auto counts = prefixCounts.drain();
+    if (counts.empty()) return;
+    
+    std::lock_guard<std::mutex> lock(writeMutex);
+    logMutations(WalOp::PrefixHits, counts);
+    updateHistory({}, {counts.begin(), counts.end()});
+    prefixMerges.fetch_add(1);
+}
+
+void Trie::logMutations(WalOp op, const std::unordered_map<string, int>& counts) {
+    WriteAheadLog* log = wal.load();
+    if (!log) return;
+    for (const auto& entry : counts) {
+        log->append(op, entry.first, (uint32_t)entry.second);
+    }
+    log->commit();
+    // Merges also run on flushEvents' caller; make sure an idle aggregator
+    // comes back to sync what the policy left unsynced
+    std::chrono::steady_clock::time_point syncAt;
+    if (log->syncPending(syncAt)) wakeAggregator();
+}
+
+void Trie::requestSnapshot() {
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        if (snapshotRequested) return;
+        snapshotRequested = true;
+    }
+    snapshotWake.notify_one();
+}
+
+void Trie::snapshotLoop() {
+    // Snapshot I/O runs here so neither request threads nor the aggregator
+    // ever wait for it
+    const auto interval = wal.load()->options().compactInterval;
+    std::unique_lock<std::mutex> lock(snapshotMutex);
+    for (;;) {
+        snapshotWake.wait_for(lock, interval, [this] {
+            return snapshotRequested || stopping.load();
+        });
+        if (stopping.load()) break;
+        bool requested = snapshotRequested;
+        snapshotRequested = false;
+        lock.unlock();
+        if (requested || wal.load()->lastLsn() > compactedLsn.load()) {
+            compactHistoryLog();
+        }
+        lock.lock();
+    }
+}
+
+void Trie::applyBatch(const vector<IngestEvent>& batch) {
+    std::unordered_map<string, int> searches;   // events per query or word
+    std::unordered_map<string, int> words;
+    
+    for (const IngestEvent& event : batch) {
+        switch (event.kind) {
+        case IngestEvent::Kind::CompleteSearch:
+            searches[event.text] += 1;
+            break;
+        case IngestEvent::Kind::UserWord:
+            words[event.text] += 1;
+            break;
+        }
+    }
+    
+    std::unordered_map<string, int> userDeltas = words;
+    vector<pair<string, int>> searchDeltas;
+    for (const auto& entry : searches) {
+        searchDeltas.emplace_back(entry.first, 10 * entry.second);
+        userDeltas[entry.first] += 10 * entry.second;
+    }
     
-    std::cout << "Recorded complete search: '" << query << "' (total count: " << searchHistory[query] << ")\n";
+    // The user trie is rebuilt from the history on startup, so it does not
+    // need to wait for the log
+    TrieNode* user = userRoot.load();
+    for (const auto& entry : searches) {
+        user->insert(entry.first, entry.second);
+    }
+    for (const auto& entry : words) {
+        user->insert(entry.first, entry.second);
+    }
+    {
+        // Logged and published in one critical section so that a compaction
+        // never checkpoints a record the history does not hold yet
+        std::lock_guard<std::mutex> lock(writeMutex);
+        logMutations(WalOp::CompleteSearch, searches);
+        logMutations(WalOp::UserWord, words);
+        updateHistory({userDeltas.begin(), userDeltas.end()}, searchDeltas);
+    }
+    
+    // Events leave the ring in order, so the first one is the oldest
+    int64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - batch.front().enqueued).count();
+    lastApplyLagNs.store(lag);
+    if (lag > maxApplyLagNs.load()) maxApplyLagNs.store(lag);
+    batches.fetch_add(1);
+    applied.fetch_add(batch.size());
+    {
+        // Taken so a flushEvents() caller is either waiting or sees the count
+        std::lock_guard<std::mutex> lock(aggregatorMutex);
+    }
+    appliedWake.notify_all();
 }
 
 // FIXED: Remove const and record search queries for prefixes length > 2
-vector<string> Trie::autoCompleteSystem(const string& prefix, int maxSuggestions) {
+vector<string> Trie::autoCompleteSystem(const string& prefix, int maxSuggestions,
+                                        QueryTrace* trace, bool timed) {
+    using Clock = std::chrono::steady_clock;
+    auto elapsedNs = [](Clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+    };
+    PROBE1(query__start, prefix.size());
+    // The counts are kept even for a caller that did not ask; query__done
+    // reports the nodes visited
+    QueryTrace local;
+    if (trace) {
+        *trace = QueryTrace();
+    } else {
+        trace = &local;
+    }
+    
+    Clock::time_point callStart, phaseStart;
+    if (timed) callStart = Clock::now();
+    
     if (prefix.empty()) {
+        PROBE3(query__done, 0, 0, 0);
         return {};
     }
     
-    std::cout << "\n=== AutoComplete Debug for '" << prefix << "' ===\n";
+    // Record search query for prefixes longer than 1 character (reduced threshold).
+    // The hit lands in this thread's own table; the aggregator merges it.
+    bool counted = prefix.length() > 1 && prefix.length() <= kMaxTextBytes;
+    if (counted) {
+        size_t pendingKeys = prefixCounts.add(prefix);
+        if (pendingKeys >= prefixCounts.limit()) {
+            prefixMergeDue.store(true, std::memory_order_relaxed);
+            wakeAggregator();
+        } else if (pendingKeys == 1) {
+            // This thread's table was empty; the aggregator may have gone
+            // to sleep without a merge scheduled
+            wakeAggregator(true);
+        }
+    }
+    
+    EpochGuard guard;
+    const TrieNode* dict = root.load();
+    const TrieNode* user = userRoot.load();
+    const HistorySnapshot& hist = *history.load();
+    
+    LOG_DEBUG << "AutoComplete for '" << prefix << "'";
     
-    // Show current search history for debugging
-    std::cout << "Current search history:\n";
-    for (const auto& entry : searchHistory) {
-        std::cout << "  '" << entry.first << "': " << entry.second << "\n";
+    // Show current search history for debugging. Walks every entry, so it
+    // only runs when debug records are kept.
+    if (Log::enabled(LogLevel::Debug)) {
+        hist.search.forEach([](const string& query, int count) {
+            LOG_DEBUG << "Search history: '" << query << "': " << count;
+        });
     }
     
-    // Record search query for prefixes longer than 1 character (reduced threshold)
-    if (prefix.length() > 1) {
-        searchHistory[prefix]++;
-        std::cout << "Auto-recorded search query: '" << prefix << "' (count: " << searchHistory[prefix] << ")\n";
+    if (counted) {
+        LOG_DEBUG << "Counted search query: '" << prefix << "' (merged count: " << hist.searchCount(prefix) << ")";
     }
     
     // Collect pairs (word, combinedFrequency)
     vector<std::pair<string, int>> allResults;
     
     // Get from user history trie and boost frequencies for searched terms
-    auto userResults = userRoot->getAllWithPrefix(prefix, maxSuggestions * 3); // Increased multiplier
+    auto userResults = user->getAllWithPrefix(prefix, maxSuggestions * 3, // Increased multiplier
+                                              nullptr, 0, &trace->user, timed);
     
-    std::cout << "User results found: " << userResults.size() << "\n";
+    LOG_DEBUG << "User results found: " << userResults.size();
+    trace->userCandidates = userResults.size();
+    if (timed) phaseStart = Clock::now();
     
     for (auto& result : userResults) {
         int boostedFreq = result.second;
-        std::cout << "Processing user result: '" << result.first << "' (base freq: " << boostedFreq << ")\n";
+        LOG_DEBUG << "Processing user result: '" << result.first << "' (base freq: " << boostedFreq << ")";
         
         // Check if this word was searched as a complete query
-        if (searchHistory.find(result.first) != searchHistory.end()) {
-            int boost = searchHistory.at(result.first) * 1000;
+        int searched = hist.searchCount(result.first);
+        if (searched != 0) {
+            int boost = searched * 1000;
             boostedFreq += boost;
-            std::cout << "  Boosting '" << result.first << "' by " << boost << " (search history)\n";
+            LOG_DEBUG << "  Boosting '" << result.first << "' by " << boost << " (search history)";
         }
         
         // Additional boost if it was added as user word
-        if (userHistory.find(result.first) != userHistory.end()) {
-            int boost = userHistory.at(result.first) * 100;
+        int added = hist.userCount(result.first);
+        if (added != 0) {
+            int boost = added * 100;
             boostedFreq += boost;
-            std::cout << "  Boosting '" << result.first << "' by " << boost << " (user history)\n";
+            LOG_DEBUG << "  Boosting '" << result.first << "' by " << boost << " (user history)";
         }
         
-        // MEGA boost if it starts with the prefix and was searched
-        for (const auto& searchEntry : searchHistory) {
-            if (searchEntry.first.find(prefix) == 0 && searchEntry.first == result.first) {
-                int megaBoost = searchEntry.second * 5000;
-                boostedFreq += megaBoost;
-                std::cout << "  MEGA BOOST for '" << result.first << "' by " << megaBoost << "\n";
-            }
+        // MEGA boost if it starts with the prefix and was searched. Every
+        // user result starts with the prefix, so this is a single lookup.
+        if (searched != 0) {
+            int megaBoost = searched * 5000;
+            boostedFreq += megaBoost;
+            LOG_DEBUG << "  MEGA BOOST for '" << result.first << "' by " << megaBoost;
         }
         
         allResults.emplace_back(result.first, boostedFreq);
-        std::cout << "  Final boosted freq for '" << result.first << "': " << boostedFreq << "\n";
+        LOG_DEBUG << "  Final boosted freq for '" << result.first << "': " << boostedFreq;
     }
+    if (timed) trace->boostNs = elapsedNs(phaseStart);
     
     // If underfilled, get from main dictionary trie
+    int64_t mergeNs = 0;
     if ((int)allResults.size() < maxSuggestions) {
-        auto dictResults = root->getAllWithPrefix(prefix, maxSuggestions);
-        std::cout << "Dictionary results found: " << dictResults.size() << "\n";
+        auto dictResults = dict->getAllWithPrefix(prefix, maxSuggestions,
+                                                  collectPool.get(), parallelThreshold,
+                                                  &trace->dict, timed);
+        LOG_DEBUG << "Dictionary results found: " << dictResults.size();
+        trace->dictConsulted = true;
+        trace->dictCandidates = dictResults.size();
+        if (timed) phaseStart = Clock::now();
         
         for (auto& p : dictResults) {
             // Check if word already exists in user results
@@ -117,19 +632,22 @@ vector<string> Trie::autoCompleteSystem(const string& prefix, int maxSuggestions
             if (it == allResults.end()) {
                 // Check if this dictionary word was ever searched
                 int dictFreq = p.second;
-                if (searchHistory.find(p.first) != searchHistory.end()) {
-                    int boost = searchHistory.at(p.first) * 500;
+                int searched = hist.searchCount(p.first);
+                if (searched != 0) {
+                    int boost = searched * 500;
                     dictFreq += boost;
-                    std::cout << "Boosting dict word '" << p.first << "' by " << boost << "\n";
+                    LOG_DEBUG << "Boosting dict word '" << p.first << "' by " << boost;
                 }
                 allResults.emplace_back(p.first, dictFreq);
                 
                 if ((int)allResults.size() >= maxSuggestions) break;
             }
         }
+        if (timed) mergeNs = elapsedNs(phaseStart);
     }
     
     // Sort by frequency descending, then lexicographically
+    if (timed) phaseStart = Clock::now();
     sort(allResults.begin(), allResults.end(),
         [](const auto& a, const auto& b) {
             if (a.second != b.second) return a.second > b.second;
@@ -143,110 +661,242 @@ vector<string> Trie::autoCompleteSystem(const string& prefix, int maxSuggestions
     
     // Extract words and log for debugging
     vector<string> suggestions;
-    std::cout << "=== Final suggestions for '" << prefix << "' ===\n";
     for (const auto& p : allResults) {
         suggestions.push_back(p.first);
-        std::cout << "Suggestion: '" << p.first << "' (freq: " << p.second << ")\n";
+        LOG_DEBUG << "Suggestion for '" << prefix << "': '" << p.first << "' (freq: " << p.second << ")";
     }
-    std::cout << "===========================================\n\n";
     
+    if (timed) {
+        trace->mergeSortNs = mergeNs + elapsedNs(phaseStart);
+        trace->totalNs = elapsedNs(callStart);
+    }
+    PROBE3(query__done, prefix.size(), suggestions.size(),
+           trace->user.nodesVisited + trace->dict.nodesVisited);
     return suggestions;
 }
 
-void Trie::saveToFile(const string& filename) const {
-    std::ofstream out(filename);
-    if (!out) {
-        std::cerr << "Cannot open " << filename << " for writing\n";
-        return;
-    }
+int Trie::loadWordList(const string& filename, unsigned threads) {
+    MappedFile file;
+    if (!file.open(filename)) return -1;
     
-    auto entries = root->getAllWithPrefix("");
-    for (auto& p : entries) {
-        out << p.first << "," << p.second << "\n";
+    int count = 0;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    rebuildPublished(root, [&](TrieNode* fresh) {
+        count = DictionaryLoader::loadLines(fresh, file.text(), threads);
+    });
+    return count;
+}
+
+int Trie::buildFromSorted(const string& filename) {
+    MappedFile file;
+    if (!file.open(filename)) return -1;
+    
+    // Built privately, outside the lock; only the swap is serialized
+    int count = 0;
+    TrieNode* fresh = DictionaryLoader::buildSorted(file.text(), count);
+    if (!fresh) {
+        LOG_INFO << filename << " is not sorted; building by insertion";
+        fresh = new TrieNode();
+        count = DictionaryLoader::loadLines(fresh, file.text());
     }
+    
+    std::lock_guard<std::mutex> lock(writeMutex);
+    Epoch::retire(root.exchange(fresh), retireTree);
+    return count;
 }
 
-void Trie::loadFromFile(const string& filename) {
-    std::ifstream in(filename);
-    if (!in) return;
-    
-    string line;
-    while (getline(in, line)) {
-        std::istringstream iss(line);
-        string word;
-        char comma;
-        int freq;
-        if (iss >> word >> comma >> freq) {
-            for (int i = 0; i < freq; ++i) {
-                root->insert(word);
-            }
+bool Trie::reloadDictionary(const string& indexFile, const string& wordList) {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    if (reloading.load()) return false;
+    if (reloader.joinable()) reloader.join();   // the previous one is done
+    
+    reloading.store(true);
+    reloader = std::thread([this, indexFile, wordList] {
+        auto start = std::chrono::steady_clock::now();
+        int count = indexFile.empty() ? -1 : loadIndex(indexFile);
+        if (count < 0) count = buildFromSorted(wordList);
+        if (count < 0) {
+            reloadsFailed.fetch_add(1);
+        } else {
+            lastReloadWords.store(count);
+            lastReloadNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+            reloadsCompleted.fetch_add(1);
+        }
+        reloading.store(false);
+    });
+    return true;
+}
+
+ReloadStats Trie::reloadStats() const {
+    ReloadStats stats;
+    stats.running = reloading.load();
+    stats.completed = reloadsCompleted.load();
+    stats.failed = reloadsFailed.load();
+    stats.lastWords = lastReloadWords.load();
+    stats.lastBuildMs = lastReloadNs.load() / 1e6;
+    return stats;
+}
+
+MemoryStats Trie::memoryStats() const {
+    // The epoch keeps the versions being walked alive if they are replaced
+    EpochGuard guard;
+    const HistorySnapshot& hist = *history.load();
+    MemoryStats stats;
+    stats.dictionary = TrieNode::memoryStats(root.load());
+    stats.userTrie = TrieNode::memoryStats(userRoot.load());
+    stats.userHistory = hist.user.memoryStats();
+    stats.searchHistory = hist.search.memoryStats();
+    return stats;
+}
+
+int Trie::loadIndex(const string& filename) {
+    size_t words = 0;
+    TrieNode* fresh = TrieIndex::load(filename, words);
+    if (!fresh) return -1;
+    
+    std::lock_guard<std::mutex> lock(writeMutex);
+    Epoch::retire(root.exchange(fresh), retireTree);
+    return (int)words;
+}
+
+void Trie::exportDictionary(const std::function<bool(std::string_view)>& sink,
+                            size_t chunkBytes) const {
+    string buffer;
+    buffer.reserve(chunkBytes + 64);
+    
+    EpochGuard guard;
+    for (WordIterator it(root.load()); it.next();) {
+        buffer += it.word();
+        buffer += ',';
+        char digits[16];
+        auto end = std::to_chars(digits, digits + sizeof(digits), it.frequency()).ptr;
+        buffer.append(digits, end);
+        buffer += '\n';
+        if (buffer.size() >= chunkBytes) {
+            if (!sink(buffer)) return;
+            buffer.clear();
         }
     }
+    if (!buffer.empty()) sink(buffer);
 }
 
-void Trie::saveUserHistory(const string& filename) const {
-    std::ofstream out(filename);
-    if (!out) {
-        std::cerr << "Cannot save user history to " << filename << "\n";
+void Trie::saveToFile(const string& filename) const {
+    std::lock_guard<std::mutex> saveLock(saveMutex);
+    EpochGuard guard;
+    if (!FrontCodedFile::write(root.load(), filename)) {
+        LOG_ERROR << "Cannot save dictionary to " << filename;
+    }
+}
+
+void Trie::loadFromFile(const string& filename) {
+    MappedFile file;
+    if (!file.open(filename)) return;
+    if (!FrontCodedFile::recognizes(file.text())) {
+        // A "word,frequency" text file, e.g. from /api/export
+        std::lock_guard<std::mutex> lock(writeMutex);
+        rebuildPublished(root, [&](TrieNode* fresh) {
+            DictionaryLoader::loadFrequencies(fresh, file.text());
+        });
         return;
     }
     
-    // Save user word history
-    out << "[USER_WORDS]\n";
-    for (const auto& entry : userHistory) {
-        out << entry.first << " " << entry.second << "\n";
-    }
+    FrontCodedFile dict;
+    if (!dict.open(filename)) return;
+    auto mergeInto = [&dict](TrieNode* target) {
+        for (size_t i = 0; i < dict.blocks(); ++i) {
+            dict.readBlock(i, [target](std::string_view word, int freq) {
+                target->insert(word, freq);
+                return true;
+            });
+        }
+    };
     
-    // Save search history
-    out << "[SEARCH_HISTORY]\n";
-    for (const auto& entry : searchHistory) {
-        out << entry.first << " " << entry.second << "\n";
+    // Into an empty dictionary the file is built privately in one pass and
+    // swapped in; otherwise its counts are added to a copy as before. The
+    // guard keeps a concurrent reload from reclaiming the root read here.
+    bool empty;
+    {
+        EpochGuard guard;
+        empty = root.load()->wordCount.load() == 0;
+    }
+    TrieNode* fresh = empty ? dict.build() : nullptr;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (fresh && root.load()->wordCount.load() == 0) {
+        Epoch::retire(root.exchange(fresh), retireTree);
+        return;
+    }
+    TrieNode::destroyTree(fresh);
+    rebuildPublished(root, mergeInto);
+}
+
+void Trie::saveUserHistory(const string& filename) const {
+    // Hold saveMutex across capture and write so concurrent saves land in
+    // order. The counter maps are immutable, so holding references to them is a
+    // consistent point-in-time view that needs no lock while writing.
+    PROBE0(history__save__start);
+    std::lock_guard<std::mutex> saveLock(saveMutex);
+    PersistentCountMap users;
+    PersistentCountMap searches;
+    size_t searchEntries, userEntries;
+    uint64_t checkpoint = 0;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const HistorySnapshot* hist = history.load();
+        users = hist->user;
+        searches = hist->search;
+        searchEntries = hist->searchSize;
+        userEntries = hist->userSize;
+        if (WriteAheadLog* log = wal.load()) checkpoint = log->lastLsn();
     }
     
-    std::cout << "Saved user history with " << searchHistory.size() << " search entries\n";
+    bool saved = HistoryFile::write(filename, users, searches, checkpoint);
+    if (saved) {
+        LOG_INFO << "Saved user history with " << searchEntries << " search entries";
+    }
+    PROBE3(history__save__done, saved, userEntries, searchEntries);
 }
 
 void Trie::loadUserHistory(const string& filename) {
-    std::ifstream in(filename);
-    if (!in) {
-        std::cout << "No existing user history file found. Starting fresh.\n";
-        return;
+    uint64_t checkpoint;
+    loadHistoryFile(filename, checkpoint);
+}
+
+bool Trie::loadHistoryFile(const string& filename, uint64_t& checkpoint) {
+    checkpoint = 0;
+    if (!std::ifstream(filename)) {
+        LOG_INFO << "No existing user history file found. Starting fresh.";
+        return true;
     }
     
-    string line;
-    bool inSearchHistory = false;
+    // Decoded in full before anything is applied, so a damaged file
+    // changes nothing
+    vector<pair<string, int>> loadedUsers;
+    vector<pair<string, int>> loadedSearches;
+    bool valid = HistoryFile::read(filename, checkpoint,
+        [&](HistoryFile::Section section, std::string_view word, int count) {
+            auto& entries = section == HistoryFile::Section::SearchHistory ? loadedSearches
+                                                                           : loadedUsers;
+            entries.emplace_back(string(word), count);
+        });
+    if (!valid) return false;
     
-    while (getline(in, line)) {
-        if (line == "[SEARCH_HISTORY]") {
-            inSearchHistory = true;
-            continue;
-        }
-        if (line == "[USER_WORDS]") {
-            inSearchHistory = false;
-            continue;
-        }
-        
-        if (line.empty()) continue;
-        
-        std::istringstream iss(line);
-        string word;
-        int freq;
-        
-        if (iss >> word >> freq) {
-            if (inSearchHistory) {
-                searchHistory[word] = freq;
-                std::cout << "Loaded search history: '" << word << "' = " << freq << "\n";
-            } else {
-                userHistory[word] = freq;
-                std::cout << "Loaded user word: '" << word << "' = " << freq << "\n";
-            }
-            
-            // Rebuild user trie
-            for (int i = 0; i < freq; ++i) {
-                userRoot->insert(word);
-            }
-        }
+    std::lock_guard<std::mutex> lock(writeMutex);
+    
+    // Rebuild user trie
+    TrieNode* user = userRoot.load();
+    for (const auto* entries : {&loadedUsers, &loadedSearches}) {
+        for (const auto& entry : *entries) user->insert(entry.first, entry.second);
     }
     
-    std::cout << "Loaded " << searchHistory.size() << " search history entries\n";
-}
\ No newline at end of file
+    // Loaded counts replace existing ones; the file has each word once per
+    // section, so the deltas can be computed in place
+    const HistorySnapshot* current = history.load();
+    for (auto& entry : loadedUsers) entry.second -= current->userCount(entry.first);
+    for (auto& entry : loadedSearches) entry.second -= current->searchCount(entry.first);
+    updateHistory(loadedUsers, loadedSearches);
+    
+    LOG_INFO << "Loaded " << history.load()->userSize << " user words and "
+             << history.load()->searchSize << " search history entries";
+    return true;
+}
@@ -0,0 +1,171 @@
+#include "TrieIndex.h"
+#include "Checksum.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const char kMagic[8] = {'A', 'C', 'T', 'R', 'I', 'E', 'I', 'X'};
+constexpr uint32_t kEndOfWord = 1u << 31;
+constexpr uint32_t kChildBits = (1u << 26) - 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t crc;
+    uint64_t nodes;
+    uint64_t words;
+};
+
+void flatten(const TrieNode* node, std::vector<uint32_t>& shape, std::vector<int32_t>& freqs) {
+    uint32_t bits = 0;
+    for (int i = 0; i < 26; ++i) {
+        if (node->child(i)) bits |= 1u << i;
+    }
+    if (node->isEndOfWord) {
+        bits |= kEndOfWord;
+        freqs.push_back(node->frequency);
+    }
+    shape.push_back(bits);
+    for (int i = 0; i < 26; ++i) {
+        if (const TrieNode* child = node->child(i)) flatten(child, shape, freqs);
+    }
+}
+
+} // namespace
+
+bool TrieIndex::write(const TrieNode* root, const string& path) {
+    std::vector<uint32_t> shape;
+    std::vector<int32_t> freqs;
+    flatten(root, shape, freqs);
+    
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.nodes = shape.size();
+    header.words = freqs.size();
+    header.crc = crc32(shape.data(), shape.size() * sizeof(uint32_t));
+    header.crc = crc32(freqs.data(), freqs.size() * sizeof(int32_t), header.crc);
+    
+    string temp = path + ".tmp";
+    std::ofstream out(temp, std::ios::binary);
+    if (!out) {
+        LOG_ERROR << "Cannot write index " << path;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(shape.data()), shape.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(freqs.data()), freqs.size() * sizeof(int32_t));
+    out.close();
+    if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+        LOG_ERROR << "Cannot write index " << path;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+TrieNode* TrieIndex::load(const string& path, size_t& words) {
+    MappedFile file;
+    if (!file.open(path)) {
+        // The index is optional; only a file that exists but cannot be read
+        // is worth a message
+        if (errno != ENOENT) {
+            LOG_ERROR << "Cannot open index " << path;
+        }
+        return nullptr;
+    }
+    std::string_view data = file.text();
+    
+    Header header;
+    if (data.size() < sizeof(header)) {
+        LOG_ERROR << "Index " << path << " is truncated";
+        return nullptr;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        LOG_ERROR << path << " is not a dictionary index";
+        return nullptr;
+    }
+    if (header.version != kVersion) {
+        LOG_ERROR << "Index " << path << " has version " << header.version
+                  << ", expected " << kVersion;
+        return nullptr;
+    }
+    size_t body = data.size() - sizeof(header);
+    if (header.nodes == 0 || header.nodes > body / 4 || header.words > body / 4 ||
+        (header.nodes + header.words) * 4 != body) {
+        LOG_ERROR << "Index " << path << " is truncated";
+        return nullptr;
+    }
+    const char* bodyData = data.data() + sizeof(header);
+    if (crc32(bodyData, body) != header.crc) {
+        LOG_ERROR << "Index " << path << " is corrupt";
+        return nullptr;
+    }
+    
+    // Pre-order: each node is the next child of the nearest open ancestor
+    // that still expects one. Subtree word counts flow up as nodes close.
+    const char* shapeData = bodyData;
+    const char* freqData = bodyData + header.nodes * 4;
+    struct Open {
+        TrieNode* node;
+        uint32_t pending;   // children not linked yet
+    };
+    std::vector<Open> stack;
+    TrieNode* block = TrieNode::allocateBlock(header.nodes);
+    size_t nextWord = 0;
+    bool valid = true;
+    for (size_t i = 0; i < header.nodes && valid; ++i) {
+        uint32_t bits;
+        std::memcpy(&bits, shapeData + i * 4, 4);
+        TrieNode* node = &block[i];
+        if (bits & kEndOfWord) {
+            if (nextWord == header.words) {
+                valid = false;
+                break;
+            }
+            int32_t freq;
+            std::memcpy(&freq, freqData + nextWord++ * 4, 4);
+            node->isEndOfWord.store(true, std::memory_order_relaxed);
+            node->frequency.store(freq, std::memory_order_relaxed);
+            node->wordCount.store(1, std::memory_order_relaxed);
+        }
+        
+        if (i > 0) {
+            while (!stack.empty() && stack.back().pending == 0) {
+                TrieNode* closed = stack.back().node;
+                stack.pop_back();
+                if (!stack.empty()) stack.back().node->wordCount.fetch_add(closed->wordCount);
+            }
+            if (stack.empty()) {
+                valid = false;
+                break;
+            }
+            Open& parent = stack.back();
+            int letter = __builtin_ctz(parent.pending);
+            parent.pending &= parent.pending - 1;
+            parent.node->children[letter].store(node, std::memory_order_relaxed);
+        }
+        stack.push_back({node, bits & kChildBits});
+    }
+    while (valid && !stack.empty()) {
+        if (stack.back().pending != 0) valid = false;
+        TrieNode* closed = stack.back().node;
+        stack.pop_back();
+        if (!stack.empty()) stack.back().node->wordCount.fetch_add(closed->wordCount);
+    }
+    
+    if (!valid || nextWord != header.words) {
+        LOG_ERROR << "Index " << path << " is inconsistent";
+        TrieNode::destroyTree(block);
+        return nullptr;
+    }
+    words = header.words;
+    return block;
+}
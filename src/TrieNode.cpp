@@ -1,27 +1,248 @@
 #include "TrieNode.h"
+#include "Probes.h"
+#include "TaskPool.h"
+#include <chrono>
 #include <iostream>
+#include <functional>
+#include <new>
+#include <sys/mman.h>
 
-TrieNode::TrieNode() : isEndOfWord(false), frequency(0) {
+namespace {
+
+// Parallel collection aims for this many tasks per pool thread, so stealing
+// can even out subtrees of different sizes
+constexpr size_t kTasksPerThread = 4;
+
+// allocateBlock keeps the mapping's length just before the first node
+constexpr size_t kBlockHeader = 64;
+
+// Adds one to wordCount on every node along `word`'s path
+void countNewWord(TrieNode* cur, std::string_view word) {
+    cur->wordCount.fetch_add(1, std::memory_order_relaxed);
+    for (char ch : word) {
+        if (ch < 'a' || ch > 'z') continue;
+        cur = cur->child(ch - 'a');
+        cur->wordCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Every collection counts its nodes and heap operations; an increment on a
+// stack-local struct is lost next to building each candidate's string
+
+void offer(std::priority_queue<Suggestion>& heap, int k, Suggestion s, CollectStats& stats) {
+    // The heap's top is its worst entry; keep s only if it beats that
+    if ((int)heap.size() < k) {
+        heap.push(std::move(s));
+        stats.heapPushes++;
+    } else if (s < heap.top()) {
+        heap.pop();
+        heap.push(std::move(s));
+        stats.heapPops++;
+        stats.heapPushes++;
+    }
+}
+
+void collect(const TrieNode* node, std::priority_queue<Suggestion>& heap, int k,
+             const string& currPrefix, CollectStats& stats) {
+    if (!node) return;
+    stats.nodesVisited++;
+    
+    if (node->isEndOfWord) {
+        offer(heap, k, Suggestion{currPrefix, node->frequency}, stats);
+    }
+    
+    for (int i = 0; i < 26; ++i) {
+        if (const TrieNode* child = node->child(i)) {
+            char next = 'a' + i;
+            collect(child, heap, k, currPrefix + next, stats);
+        }
+    }
 }
 
-void TrieNode::insert(const string& word) {
+void collectParallel(const TrieNode* node, std::priority_queue<Suggestion>& heap, int k,
+                     const string& currPrefix, TaskPool& pool, CollectStats& stats) {
+    // Split the largest remaining subtree into its children until there are
+    // enough tasks; words ending on a split node are offered directly.
+    vector<pair<const TrieNode*, string>> parts{{node, currPrefix}};
+    size_t target = pool.size() * kTasksPerThread;
+    while (parts.size() < target) {
+        auto largest = std::max_element(parts.begin(), parts.end(),
+            [](const auto& a, const auto& b) { return a.first->wordCount < b.first->wordCount; });
+        if (largest->first->wordCount <= 1) break;
+        
+        auto split = *largest;
+        parts.erase(largest);
+        stats.nodesVisited++;
+        if (split.first->isEndOfWord) {
+            offer(heap, k, Suggestion{split.second, split.first->frequency}, stats);
+        }
+        for (int i = 0; i < 26; ++i) {
+            if (const TrieNode* child = split.first->child(i)) {
+                parts.emplace_back(child, split.second + char('a' + i));
+            }
+        }
+    }
+    
+    // Each task counts into its own stats; they are summed once all finish
+    vector<std::priority_queue<Suggestion>> heaps(parts.size());
+    vector<CollectStats> partStats(parts.size());
+    vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        tasks.emplace_back([&parts, &heaps, &partStats, i, k] {
+            collect(parts[i].first, heaps[i], k, parts[i].second, partStats[i]);
+        });
+    }
+    pool.runAll(tasks);
+    
+    for (const CollectStats& part : partStats) {
+        stats.nodesVisited += part.nodesVisited;
+        stats.heapPushes += part.heapPushes;
+        stats.heapPops += part.heapPops;
+    }
+    for (auto& local : heaps) {
+        while (!local.empty()) {
+            offer(heap, k, local.top(), stats);
+            local.pop();
+            stats.heapPops++;
+        }
+    }
+}
+
+} // namespace
+
+TrieNode::TrieNode() : isEndOfWord(false), frequency(0), wordCount(0) {
+    for (auto& child : children) {
+        child.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+void TrieNode::insert(std::string_view word, int count) {
+    if (count <= 0) return;
     TrieNode* cur = this;
     for (char ch : word) {
         if (ch < 'a' || ch > 'z') continue;
         int index = ch - 'a';
-        if (!cur->children[index])
-            cur->children[index] = std::make_unique<TrieNode>();
-        cur = cur->children[index].get();
+        TrieNode* next = cur->child(index);
+        if (!next) {
+            // Racing inserters each build a node; one CAS wins and the
+            // losers adopt the winner's node
+            TrieNode* fresh = new TrieNode();
+            if (cur->children[index].compare_exchange_strong(next, fresh,
+                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+                next = fresh;
+            } else {
+                delete fresh;
+            }
+        }
+        cur = next;
     }
     
-    if (cur->isEndOfWord) 
-        cur->frequency++;
-    else { 
-        cur->isEndOfWord = true; 
-        cur->frequency = 1;
+    // Count first, so a reader that sees the end flag sees a frequency too;
+    // exactly one inserter of a new word turns the flag on and counts it
+    cur->frequency.fetch_add(count, std::memory_order_release);
+    if (!cur->isEndOfWord.exchange(true, std::memory_order_acq_rel)) {
+        countNewWord(this, word);
     }
 }
 
+TrieNode* TrieNode::cloneTree(const TrieNode* node) {
+    if (!node) return nullptr;
+    TrieNode* copy = new TrieNode();
+    copy->isEndOfWord.store(node->isEndOfWord.load());
+    copy->frequency.store(node->frequency.load());
+    copy->wordCount.store(node->wordCount.load());
+    for (int i = 0; i < 26; ++i) {
+        copy->children[i].store(cloneTree(node->child(i)), std::memory_order_relaxed);
+    }
+    return copy;
+}
+
+bool TrieNode::equalTree(const TrieNode* a, const TrieNode* b) {
+    if (!a || !b) return a == b;
+    if (a->isEndOfWord != b->isEndOfWord || a->frequency != b->frequency ||
+        a->wordCount != b->wordCount) return false;
+    for (int i = 0; i < 26; ++i) {
+        if (!equalTree(a->child(i), b->child(i))) return false;
+    }
+    return true;
+}
+
+static void measure(const TrieNode* node, size_t depth, TrieMemoryStats& stats,
+                    size_t& parents) {
+    stats.nodes++;
+    if (node->isEndOfWord) stats.terminalNodes++;
+    if (stats.depthHistogram.size() <= depth) stats.depthHistogram.resize(depth + 1);
+    stats.depthHistogram[depth]++;
+    switch (node->storage) {
+    case TrieNode::Storage::Heap:
+        stats.heapNodes++;
+        stats.bytes += sizeof(TrieNode);
+        break;
+    case TrieNode::Storage::Block:
+        break;
+    case TrieNode::Storage::BlockOwner:
+        stats.bytes += *reinterpret_cast<const size_t*>(
+            reinterpret_cast<const char*>(node) - kBlockHeader);
+        break;
+    }
+    
+    size_t children = 0;
+    for (int i = 0; i < 26; ++i) {
+        if (const TrieNode* child = node->child(i)) {
+            children++;
+            measure(child, depth + 1, stats, parents);
+        }
+    }
+    stats.childLinks += children;
+    if (children > 0) parents++;
+}
+
+TrieMemoryStats TrieNode::memoryStats(const TrieNode* root) {
+    TrieMemoryStats stats;
+    if (!root) return stats;
+    size_t parents = 0;
+    measure(root, 0, stats, parents);
+    stats.averageFanout = parents ? double(stats.childLinks) / parents : 0;
+    stats.terminalRatio = double(stats.terminalNodes) / stats.nodes;
+    stats.childSlotUse = double(stats.childLinks) / (26.0 * stats.nodes);
+    return stats;
+}
+
+void TrieNode::destroyTree(TrieNode* node) {
+    if (!node) return;
+    for (int i = 0; i < 26; ++i) {
+        destroyTree(node->child(i));
+    }
+    switch (node->storage) {
+    case Storage::Heap: delete node; break;
+    case Storage::Block: break;
+    case Storage::BlockOwner: {
+        char* mapping = reinterpret_cast<char*>(node) - kBlockHeader;
+        ::munmap(mapping, *reinterpret_cast<size_t*>(mapping));
+        break;
+    }
+    }
+}
+
+TrieNode* TrieNode::allocateBlock(size_t count) {
+    // One anonymous mapping, on transparent huge pages where the kernel
+    // allows it: a full dictionary is hundreds of MB of nodes, and touching
+    // it in 4 KB pages costs more than building the trie
+    size_t bytes = kBlockHeader + count * sizeof(TrieNode);
+    void* mapping = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) throw std::bad_alloc();
+    ::madvise(mapping, bytes, MADV_HUGEPAGE);
+    *static_cast<size_t*>(mapping) = bytes;
+    
+    TrieNode* block = reinterpret_cast<TrieNode*>(static_cast<char*>(mapping) + kBlockHeader);
+    for (size_t i = 0; i < count; ++i) {
+        new (&block[i]) TrieNode();
+        block[i].storage = i == 0 ? Storage::BlockOwner : Storage::Block;
+    }
+    return block;
+}
+
 void TrieNode::insertUserWord(const string& word) {
     // Same as insert, but can be used for user-specific insertions
     insert(word);
@@ -32,8 +253,8 @@ bool TrieNode::search(const string& word) const {
     for (char ch : word) {
         if (ch < 'a' || ch > 'z') continue;
         int index = ch - 'a';
-        if (!cur->children[index]) return false;
-        cur = cur->children[index].get();
+        cur = cur->child(index);
+        if (!cur) return false;
     }
     return cur->isEndOfWord;
 }
@@ -41,39 +262,53 @@ bool TrieNode::search(const string& word) const {
 void TrieNode::autoComplete(const TrieNode* node, 
                            std::priority_queue<Suggestion>& heap, 
                            int k, 
-                           const string& currPrefix) const {
-    if (!node) return;
-    
-    if (node->isEndOfWord) {
-        Suggestion s{currPrefix, node->frequency};
-        if ((int)heap.size() < k) {
-            heap.push(s);
-        } else if (heap.top() < s) {
-            heap.pop();
-            heap.push(s);
-        }
-    }
-    
-    for (int i = 0; i < 26; ++i) {
-        if (node->children[i]) {
-            char next = 'a' + i;
-            autoComplete(node->children[i].get(), heap, k, currPrefix + next);
-        }
-    }
+                           const string& currPrefix,
+                           CollectStats* stats) const {
+    CollectStats local;
+    collect(node, heap, k, currPrefix, stats ? *stats : local);
 }
 
-vector<pair<string, int>> TrieNode::getAllWithPrefix(const string& prefix, int k) const {
+vector<pair<string, int>> TrieNode::getAllWithPrefix(const string& prefix, int k,
+                                                     TaskPool* pool,
+                                                     int parallelThreshold,
+                                                     CollectStats* stats,
+                                                     bool timed) const {
+    using Clock = std::chrono::steady_clock;
+    auto elapsedNs = [](Clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+    };
+    PROBE2(collect__start, prefix.size(), k);
+    CollectStats local;
+    if (stats) {
+        *stats = CollectStats();
+    } else {
+        stats = &local;
+    }
+    
+    Clock::time_point start;
+    if (timed) start = Clock::now();
+    
     const TrieNode* cur = this;
     for (char ch : prefix) {
-        if (ch < 'a' || ch > 'z') return {};
-        int index = ch - 'a';
-        if (!cur->children[index]) return {};
-        cur = cur->children[index].get();
+        cur = ch >= 'a' && ch <= 'z' ? cur->child(ch - 'a') : nullptr;
+        if (!cur) {
+            if (timed) stats->descentNs = elapsedNs(start);
+            PROBE3(collect__done, prefix.size(), 0, 0);
+            return {};
+        }
+    }
+    if (timed) {
+        stats->descentNs = elapsedNs(start);
+        start = Clock::now();
     }
     
     std::priority_queue<Suggestion> heap;
     int maxSuggestions = k;
-    autoComplete(cur, heap, maxSuggestions, prefix);
+    if (pool && parallelThreshold > 0 && cur->wordCount >= parallelThreshold) {
+        autoCompleteParallel(cur, heap, maxSuggestions, prefix, *pool, stats);
+    } else {
+        autoComplete(cur, heap, maxSuggestions, prefix, stats);
+    }
     
     vector<pair<string, int>> results;
     while (!heap.empty()) {
@@ -82,9 +317,24 @@ vector<pair<string, int>> TrieNode::getAllWithPrefix(const string& prefix, int k
     }
     
     std::reverse(results.begin(), results.end());
+    stats->heapPops += results.size();
+    if (timed) stats->traversalNs = elapsedNs(start);
+    PROBE3(collect__done, prefix.size(), results.size(), stats->nodesVisited);
     return results;
 }
 
+void TrieNode::autoCompleteParallel(const TrieNode* node,
+                                    std::priority_queue<Suggestion>& heap,
+                                    int k,
+                                    const string& currPrefix,
+                                    TaskPool& pool,
+                                    CollectStats* stats) const {
+    CollectStats local;
+    if (!stats) stats = &local;
+    stats->parallel = true;
+    collectParallel(node, heap, k, currPrefix, pool, *stats);
+}
+
 void TrieNode::sortResults(vector<pair<string, int>>& results) const {
     std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
         if (a.second != b.second) return a.second > b.second;
@@ -1,36 +1,205 @@
 #include "crow/app.h"
 #include "crow/middlewares/cors.h"
+#include "HistoryFile.h"
+#include "Log.h"
+#include "Probes.h"
+#include "RequestMetrics.h"
+#include "SlowQueryLog.h"
 #include "Trie.h"
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <unistd.h>
 
 using namespace crow;
 
+// Dictionary sources, read at startup and again on every reload
+static const std::string kDictionaryIndex = "src/dictionary/words_alpha.idx";
+static const std::string kDictionaryWords = "src/dictionary/words_alpha.txt";
+static const std::string kHistorySnapshot = "user_history.bin";
+static const std::string kHistoryLog = "user_history.wal";
+static const std::string kLegacyHistory = "user_history.txt";
+static const std::string kSlowQueryLog = "slow_queries.log";
+
+// Hands crow's log records to our logger instead of writing them to stderr
+// on the calling thread
+class CrowLogHandler : public crow::ILogHandler {
+public:
+    void log(const std::string& message, crow::LogLevel level) override {
+        switch (level) {
+        case crow::LogLevel::Debug: LOG_DEBUG << message; break;
+        case crow::LogLevel::Info: LOG_INFO << message; break;
+        case crow::LogLevel::Warning: LOG_WARN << message; break;
+        default: LOG_ERROR << message; break;
+        }
+    }
+};
+
+// The breakdown /api/suggest?trace=1 returns; times in nanoseconds, left
+// out when the phases were not timed
+static crow::json::wvalue traceJson(const QueryTrace& trace, bool timed) {
+    crow::json::wvalue json;
+    if (timed) {
+        json["total_ns"] = trace.totalNs;
+        json["prefix_descent_ns"] = trace.user.descentNs + trace.dict.descentNs;
+        json["user_traversal_ns"] = trace.user.traversalNs;
+        json["dict_traversal_ns"] = trace.dict.traversalNs;
+        json["boost_ns"] = trace.boostNs;
+        json["merge_sort_ns"] = trace.mergeSortNs;
+        json["serialize_ns"] = trace.serializeNs;
+    }
+    json["user_nodes_visited"] = trace.user.nodesVisited;
+    json["dict_nodes_visited"] = trace.dict.nodesVisited;
+    json["heap_pushes"] = trace.user.heapPushes + trace.dict.heapPushes;
+    json["heap_pops"] = trace.user.heapPops + trace.dict.heapPops;
+    json["user_candidates"] = trace.userCandidates;
+    json["dict_candidates"] = trace.dictCandidates;
+    json["dict_consulted"] = trace.dictConsulted;
+    json["dict_parallel"] = trace.dict.parallel;
+    return json;
+}
+
+static crow::json::wvalue trieMemoryJson(const TrieMemoryStats& stats) {
+    crow::json::wvalue json;
+    json["nodes"] = stats.nodes;
+    json["terminal_nodes"] = stats.terminalNodes;
+    json["heap_nodes"] = stats.heapNodes;
+    json["node_size"] = sizeof(TrieNode);
+    json["bytes"] = stats.bytes;
+    json["child_links"] = stats.childLinks;
+    json["average_fanout"] = stats.averageFanout;
+    json["terminal_ratio"] = stats.terminalRatio;
+    json["child_slot_use"] = stats.childSlotUse;
+    json["depth_histogram"] = crow::json::wvalue::list();
+    for (size_t depth = 0; depth < stats.depthHistogram.size(); ++depth)
+        json["depth_histogram"][depth] = stats.depthHistogram[depth];
+    return json;
+}
+
+static crow::json::wvalue historyMemoryJson(const HistoryMemoryStats& stats) {
+    crow::json::wvalue json;
+    json["entries"] = stats.entries;
+    json["nodes"] = stats.nodes;
+    json["key_bytes"] = stats.keyBytes;
+    json["bytes"] = stats.bytes;
+    return json;
+}
+
+// Times every request from routing to response, counts it by status and
+// fires the request__start/request__done probes around it.
+// Listed first so that it also covers the CORS handler's work.
+struct LatencyMiddleware {
+    struct context {
+        std::chrono::steady_clock::time_point start;
+    };
+
+    RequestMetrics* metrics = nullptr;
+
+    void before_handle(crow::request& req, crow::response&, context& ctx) {
+        PROBE2(request__start, req.url.c_str(), int(req.method));
+        ctx.start = std::chrono::steady_clock::now();
+    }
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {
+        if (!metrics) return;
+        size_t route = metrics->route(req.url);
+        // Crow answers a URL no route matches before any before_handle runs
+        if (ctx.start == std::chrono::steady_clock::time_point()) {
+            metrics->record(route, res.code);
+            PROBE3(request__done, req.url.c_str(), res.code, 0);
+            return;
+        }
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - ctx.start).count();
+        metrics->record(route, res.code, ns);
+        PROBE3(request__done, req.url.c_str(), res.code, ns);
+        ctx.start = {};   // the context is reused by the connection's next request
+    }
+};
+
 int main() {
+    // LOG_LEVEL=debug|info|warn|error|off picks what is logged at runtime;
+    // debug records also need a build with `make LOG_LEVEL=0`
+    if (const char* level = std::getenv("LOG_LEVEL")) {
+        ::LogLevel parsed;
+        if (Log::parseLevel(level, parsed)) {
+            Log::setLevel(parsed);
+        } else {
+            LOG_WARN << "Unknown LOG_LEVEL '" << level << "', keeping info";
+        }
+    }
+
+    // Suggest requests slower than SLOW_QUERY_MS (default 10; 0 turns it
+    // off) go to slow_queries.log and /api/debug/slow
+    double slowMs = 10;
+    if (const char* value = std::getenv("SLOW_QUERY_MS")) slowMs = std::atof(value);
+    SlowQueryLog slowQueries(int64_t(slowMs * 1e6), 256);
+    if (slowQueries.enabled() && !slowQueries.open(kSlowQueryLog)) {
+        LOG_WARN << "Cannot open " << kSlowQueryLog << "; slow queries are kept in memory only";
+    }
+
     // Create our trie instance
     ::Trie trie;
 
-    // Load dictionary
-    std::ifstream infile("src/dictionary/words_alpha.txt");
-    if (!infile.is_open()) {
-        std::cerr << "Warning: Could not open dictionary file. Using empty dictionary.\n";
+    // Load dictionary: the index `make indexer` prebuilds if there is one,
+    // else the word list (sorted, so built in one pass)
+    int count = trie.loadIndex(kDictionaryIndex);
+    if (count < 0) {
+        LOG_INFO << "No usable dictionary index; building from the word list";
+        count = trie.buildFromSorted(kDictionaryWords);
+    }
+    if (count < 0) {
+        LOG_WARN << "Could not open dictionary file. Using empty dictionary.";
     } else {
-        std::string word;
-        int count = 0;
-        while (getline(infile, word)) {
-            trie.insert(word);
-            count++;
-        }
-        std::cout << "Loaded " << count << " words from dictionary\n";
+        LOG_INFO << "Loaded " << count << " words from dictionary";
     }
 
-    // Load persisted history
-    trie.loadUserHistory("user_history.txt");
-    std::cout << "Loaded user search history\n";
+    // Short prefixes span tens of thousands of words; on many-core boxes
+    // collect those on a pool of their own. The cores are split between
+    // crow's request handlers and that pool so that, even when every
+    // handler forks a collection at once, no more threads are runnable
+    // than there are cores (the forking handler runs tasks too).
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned collectThreads = cores > 2 ? std::max(1u, cores / 4) : 0;
+    unsigned handlerThreads = cores - collectThreads;
+    if (collectThreads > 0) {
+        trie.setParallelCollection(20000, collectThreads);
+    }
+
+    // Snapshots used to be written as text to user_history.txt; carry one
+    // over into the binary snapshot the first time (its checkpoint comes
+    // along, so the log replays on top of it as before)
+    if (!std::ifstream(kHistorySnapshot) && std::ifstream(kLegacyHistory)) {
+        HistoryFile::convert(kLegacyHistory, kHistorySnapshot, false);
+    }
+    
+    // Load persisted history: the last snapshot plus the log written since.
+    // Searches and user words are applied and logged by the Trie's aggregator.
+    if (trie.openHistoryLog(kHistorySnapshot, kHistoryLog)) {
+        LOG_INFO << "Loaded user search history";
+    } else {
+        LOG_WARN << "User history is not being persisted";
+    }
 
-    // Create app with CORS middleware
-    App<crow::CORSHandler> app;
+    // Create app with latency and CORS middleware
+    App<LatencyMiddleware, crow::CORSHandler> app;
+    RequestMetrics metrics({"/api/health", "/api/suggest", "/api/search", "/api/userword",
+                            "/api/debug/ingest", "/api/debug/slow", "/api/debug/memory",
+                            "/api/export", "/api/admin/reload", "/api/metrics"});
+    app.get_middleware<LatencyMiddleware>().metrics = &metrics;
+    // Crow logs every request at info; hold it to the same level as ours and
+    // send its records through the same rings
+    const crow::LogLevel crowLevels[] = {crow::LogLevel::Debug, crow::LogLevel::Info,
+                                         crow::LogLevel::Warning, crow::LogLevel::Error,
+                                         crow::LogLevel::Critical};
+    app.loglevel(crowLevels[int(Log::level())]);
+    static CrowLogHandler crowLog;
+    crow::logger::setHandler(&crowLog);
     
     // Configure CORS
     auto& cors = app.get_middleware<crow::CORSHandler>();
@@ -58,27 +227,54 @@ int main() {
 
     // Suggest endpoint
     CROW_ROUTE(app, "/api/suggest")
-    ([&trie](const crow::request& req) {
+    ([&trie, &slowQueries](const crow::request& req) {
+        auto start = std::chrono::steady_clock::now();
         auto prefix = req.url_params.get("prefix") ? req.url_params.get("prefix") : "";
-        std::cout << "Suggestion request for prefix: '" << prefix << "'\n";
+        LOG_INFO << "Suggestion request for prefix: '" << prefix << "'";
         
-        auto suggestions = trie.autoCompleteSystem(prefix);
+        // trace=1 adds where the request spent its time to the response.
+        // Otherwise only the slow-query log's sample has its phases timed,
+        // so that the slow ones among them keep their breakdown; every
+        // request has its counts.
+        const char* traceParam = req.url_params.get("trace");
+        bool traced = traceParam && std::string(traceParam) == "1";
+        bool sampled = !traced && slowQueries.sampleTrace();
+        QueryTrace trace;
+        auto suggestions = trie.autoCompleteSystem(prefix, 10, &trace, traced || sampled);
         
+        auto serializeStart = std::chrono::steady_clock::now();
         crow::json::wvalue result;
         for (size_t i = 0; i < suggestions.size(); ++i)
             result["suggestions"][i] = suggestions[i];
+        if (traced) {
+            // Timed on a throwaway dump, since the response's own dump has to
+            // include the trace
+            result.dump();
+            trace.serializeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - serializeStart).count();
+            result["trace"] = traceJson(trace, true);
+        }
 
         crow::response res(result);
         res.set_header("Content-Type", "application/json");
-        std::cout << "Sent " << suggestions.size() << " suggestions\n";
+        LOG_INFO << "Sent " << suggestions.size() << " suggestions";
+        if (slowQueries.enabled()) {
+            // Sampled, the response's own dump is the serialization
+            if (sampled) {
+                trace.serializeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - serializeStart).count();
+            }
+            slowQueries.offer(prefix, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count(),
+                trace, traced || sampled);
+        }
         return res;
     });
 
     // Complete search endpoint
     CROW_ROUTE(app, "/api/search").methods("POST"_method)
     ([&trie](const crow::request& req) {
-        std::cout << "Search request received\n";
-        std::cout << "Request body: " << req.body << "\n";
+        LOG_DEBUG << "Search request body: " << req.body;
         
         auto body = crow::json::load(req.body);
         if (!body || !body.has("query")) {
@@ -92,10 +288,26 @@ int main() {
         }
 
         std::string q = body["query"].s();
-        std::cout << "Recording complete search: " << q << "\n";
+        if (q.size() > ::Trie::kMaxTextBytes) {
+            crow::json::wvalue error_resp;
+            error_resp["error"] = "Payload Too Large";
+            error_resp["message"] = "Query is longer than " + std::to_string(::Trie::kMaxTextBytes) + " bytes";
+            
+            crow::response res(413, error_resp);
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
+        LOG_INFO << "Recording complete search: " << q;
         
-        trie.recordCompleteSearch(q);
-        trie.saveUserHistory("user_history.txt");
+        if (!trie.submitCompleteSearch(q)) {
+            crow::json::wvalue error_resp;
+            error_resp["error"] = "Service Unavailable";
+            error_resp["message"] = "Event queue is full, try again";
+            
+            crow::response res(503, error_resp);
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
 
         crow::json::wvalue resp;
         resp["status"] = "success";
@@ -122,8 +334,24 @@ int main() {
         }
 
         std::string w = body["word"].s();
-        trie.insertUserWord(w);
-        trie.saveUserHistory("user_history.txt");
+        if (w.size() > ::Trie::kMaxTextBytes) {
+            crow::json::wvalue error_resp;
+            error_resp["error"] = "Payload Too Large";
+            error_resp["message"] = "Word is longer than " + std::to_string(::Trie::kMaxTextBytes) + " bytes";
+            
+            crow::response res(413, error_resp);
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
+        if (!trie.submitUserWord(w)) {
+            crow::json::wvalue error_resp;
+            error_resp["error"] = "Service Unavailable";
+            error_resp["message"] = "Event queue is full, try again";
+            
+            crow::response res(503, error_resp);
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
 
         crow::json::wvalue resp;
         resp["status"] = "success";
@@ -135,13 +363,170 @@ int main() {
         return res;
     });
 
-    std::cout << "Starting server on port 8080...\n";
-    std::cout << "API endpoints available:\n";
-    std::cout << "  GET  /api/health\n";
-    std::cout << "  GET  /api/suggest?prefix=<word>\n";
-    std::cout << "  POST /api/search {\"query\": \"word\"}\n";
-    std::cout << "  POST /api/userword {\"word\": \"word\"}\n";
+    // Ingestion queue metrics
+    CROW_ROUTE(app, "/api/debug/ingest")
+    ([&trie]() {
+        IngestStats stats = trie.ingestStats();
+        
+        crow::json::wvalue json_resp;
+        json_resp["depth"] = stats.depth;
+        json_resp["capacity"] = stats.capacity;
+        json_resp["enqueued"] = stats.enqueued;
+        json_resp["applied"] = stats.applied;
+        json_resp["dropped"] = stats.dropped;
+        json_resp["batches"] = stats.batches;
+        json_resp["last_apply_lag_ms"] = stats.lastApplyLagMs;
+        json_resp["max_apply_lag_ms"] = stats.maxApplyLagMs;
+        json_resp["prefix_merges"] = stats.prefixMerges;
+        json_resp["pending_prefix_keys"] = stats.pendingPrefixKeys;
+        json_resp["wal_bytes"] = stats.walBytes;
+        json_resp["wal_syncs"] = stats.walSyncs;
+        json_resp["wal_failed_appends"] = stats.walFailedAppends;
+        json_resp["wal_failed_syncs"] = stats.walFailedSyncs;
+        json_resp["compactions"] = stats.compactions;
+        json_resp["snapshot_interval_ms"] = stats.snapshotIntervalMs;
+        json_resp["last_snapshot_age_ms"] = stats.lastSnapshotAgeMs;
+        json_resp["last_snapshot_write_ms"] = stats.lastSnapshotWriteMs;
+        json_resp["last_snapshot_pause_ms"] = stats.lastSnapshotPauseMs;
+        json_resp["max_snapshot_pause_ms"] = stats.maxSnapshotPauseMs;
+        json_resp["log_dropped"] = Log::dropped();
+        
+        crow::response res(json_resp);
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    // Node counts, shape and estimated bytes of the tries and the history
+    // counters. Walks all of them, so it takes a while on a full dictionary.
+    CROW_ROUTE(app, "/api/debug/memory")
+    ([&trie]() {
+        MemoryStats stats = trie.memoryStats();
+        
+        crow::json::wvalue json_resp;
+        json_resp["dictionary"] = trieMemoryJson(stats.dictionary);
+        json_resp["user_trie"] = trieMemoryJson(stats.userTrie);
+        json_resp["user_history"] = historyMemoryJson(stats.userHistory);
+        json_resp["search_history"] = historyMemoryJson(stats.searchHistory);
+        json_resp["total_bytes"] = stats.dictionary.bytes + stats.userTrie.bytes +
+                                   stats.userHistory.bytes + stats.searchHistory.bytes;
+        
+        crow::response res(json_resp);
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    // The most recent slow suggest requests, oldest first
+    CROW_ROUTE(app, "/api/debug/slow")
+    ([&slowQueries]() {
+        crow::json::wvalue json_resp;
+        json_resp["threshold_ns"] = slowQueries.threshold();
+        json_resp["recorded"] = slowQueries.recorded();
+        json_resp["queries"] = crow::json::wvalue::list();
+        vector<SlowQuery> queries = slowQueries.recent();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            crow::json::wvalue query = traceJson(queries[i].trace, queries[i].traced);
+            query["traced"] = queries[i].traced;
+            query["time_ms"] = queries[i].unixMs;
+            query["prefix"] = queries[i].prefix;
+            query["request_ns"] = queries[i].totalNs;
+            query["thread"] = queries[i].threadId;
+            json_resp["queries"][i] = std::move(query);
+        }
+        
+        crow::response res(json_resp);
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    // Request latency and status counts, in Prometheus text format
+    CROW_ROUTE(app, "/api/metrics")
+    ([&metrics]() {
+        crow::response res(metrics.prometheus());
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
+    });
+
+    // Dictionary export as "word,frequency" lines. exportDictionary streams
+    // the words into a temp file a chunk at a time and crow sends the file
+    // from disk, so memory stays at one chunk whatever the dictionary's size
+    CROW_ROUTE(app, "/api/export")
+    ([&trie](const crow::request&, crow::response& res) {
+        std::string path = std::filesystem::temp_directory_path() / "autocomplete-export-XXXXXX.txt";
+        int fd = ::mkstemps(path.data(), 4);
+        bool written = false;
+        if (fd >= 0) {
+            ::close(fd);
+            std::ofstream out(path, std::ios::binary);
+            trie.exportDictionary([&out](std::string_view chunk) {
+                out.write(chunk.data(), (std::streamsize)chunk.size());
+                return bool(out);
+            });
+            out.close();
+            written = bool(out);
+        }
+        if (!written) {
+            LOG_ERROR << "Cannot write the dictionary export to " << path;
+            if (fd >= 0) std::remove(path.c_str());
+            res.code = 500;
+            res.end();
+            return;
+        }
+        
+        res.set_static_file_info_unsafe(path);
+        // Crow writes a static file out before end() returns, so nothing
+        // reads it after this
+        res.end();
+        std::remove(path.c_str());
+    });
+
+    // Dictionary hot reload: rebuilds from the same sources in the background
+    // and swaps the result in; histories and the user trie are kept
+    CROW_ROUTE(app, "/api/admin/reload").methods("POST"_method)
+    ([&trie]() {
+        crow::json::wvalue resp;
+        if (!trie.reloadDictionary(kDictionaryIndex, kDictionaryWords)) {
+            resp["error"] = "A reload is already running";
+            crow::response res(409, resp);
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
+        resp["status"] = "started";
+        crow::response res(202, resp);
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    CROW_ROUTE(app, "/api/admin/reload").methods("GET"_method)
+    ([&trie]() {
+        ReloadStats stats = trie.reloadStats();
+        
+        crow::json::wvalue json_resp;
+        json_resp["running"] = stats.running;
+        json_resp["completed"] = stats.completed;
+        json_resp["failed"] = stats.failed;
+        json_resp["last_words"] = stats.lastWords;
+        json_resp["last_build_ms"] = stats.lastBuildMs;
+        
+        crow::response res(json_resp);
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    LOG_INFO << "Starting server on port 8080...\n"
+             << "API endpoints available:\n"
+             << "  GET  /api/health\n"
+             << "  GET  /api/suggest?prefix=<word>\n"
+             << "  POST /api/search {\"query\": \"word\"}\n"
+             << "  POST /api/userword {\"word\": \"word\"}\n"
+             << "  GET  /api/debug/ingest\n"
+             << "  GET  /api/debug/slow\n"
+             << "  GET  /api/debug/memory\n"
+             << "  GET  /api/metrics\n"
+             << "  GET  /api/export\n"
+             << "  POST /api/admin/reload\n"
+             << "  GET  /api/admin/reload";
     
-    app.port(8080).multithreaded().run();
+    // crow runs concurrency - 1 handler threads plus one that only accepts
+    app.port(8080).concurrency(handlerThreads + 1).run();
     return 0;
 }
\ No newline at end of file
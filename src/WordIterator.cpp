@@ -0,0 +1,34 @@
+#include "WordIterator.h"
+
+WordIterator::WordIterator(const TrieNode* root) {
+    if (root) stack.push_back({root, -1});
+}
+
+bool WordIterator::next() {
+    while (!stack.empty()) {
+        Frame& top = stack.back();
+        if (top.nextChild < 0) {
+            // Pre-order: a word comes before every word it prefixes
+            top.nextChild = 0;
+            if (top.node->isEndOfWord.load(std::memory_order_acquire)) {
+                freq = top.node->frequency.load(std::memory_order_acquire);
+                return true;
+            }
+        }
+        
+        while (top.nextChild < 26 && !top.node->child(top.nextChild)) {
+            top.nextChild++;
+        }
+        if (top.nextChild == 26) {
+            stack.pop_back();
+            if (!stack.empty()) current.pop_back();   // the root adds no letter
+            continue;
+        }
+        
+        const TrieNode* child = top.node->child(top.nextChild);
+        current.push_back(char('a' + top.nextChild));
+        top.nextChild++;
+        stack.push_back({child, -1});
+    }
+    return false;
+}
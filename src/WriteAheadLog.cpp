@@ -0,0 +1,255 @@
+#include "WriteAheadLog.h"
+#include "Checksum.h"
+#include "Log.h"
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = {'A', 'C', 'W', 'A', 'L', 0, 0, 1};
+constexpr size_t kRecordHeader = 8;                 // size + crc
+constexpr size_t kPayloadFixed = 8 + 1 + 4;         // lsn + op + count
+constexpr size_t kMaxPayload = kPayloadFixed + WriteAheadLog::kMaxText;
+
+// Parses intact records from `data`; returns the length of the valid prefix
+size_t parse(const std::vector<char>& data, uint64_t after, uint64_t& last,
+             const std::function<void(const WalRecord&)>& apply) {
+    if (data.size() < sizeof(kMagic) || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+        return 0;
+    
+    size_t pos = sizeof(kMagic);
+    while (data.size() - pos >= kRecordHeader) {
+        uint32_t payloadSize, crc;
+        std::memcpy(&payloadSize, &data[pos], 4);
+        std::memcpy(&crc, &data[pos + 4], 4);
+        if (payloadSize < kPayloadFixed || payloadSize > kMaxPayload ||
+            data.size() - pos - kRecordHeader < payloadSize) break;
+        const char* payload = &data[pos + kRecordHeader];
+        if (crc32(payload, payloadSize) != crc) break;
+        
+        WalRecord record;
+        uint8_t op;
+        std::memcpy(&record.lsn, payload, 8);
+        std::memcpy(&op, payload + 8, 1);
+        std::memcpy(&record.count, payload + 9, 4);
+        record.op = static_cast<WalOp>(op);
+        record.text.assign(payload + kPayloadFixed, payloadSize - kPayloadFixed);
+        
+        if (record.lsn > after) apply(record);
+        if (record.lsn > last) last = record.lsn;
+        pos += kRecordHeader + payloadSize;
+    }
+    return pos;
+}
+
+std::vector<char> readAll(const string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const WalOptions& options) : opts(options) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd >= 0) {
+        if (dirty) sync();
+        ::close(fd);
+    }
+}
+
+uint64_t WriteAheadLog::replay(const string& path, uint64_t after,
+                               const std::function<void(const WalRecord&)>& apply) {
+    uint64_t last = after;
+    parse(readAll(path), after, last, apply);
+    return last;
+}
+
+bool WriteAheadLog::open(const string& filename, uint64_t firstLsn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t ignored = 0;
+    size_t valid = parse(readAll(filename), UINT64_MAX, ignored, [](const WalRecord&) {});
+    
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        LOG_ERROR << "Cannot open write-ahead log " << filename;
+        return false;
+    }
+    path = filename;
+    nextLsn = firstLsn;
+    if (valid == 0) {
+        // New file, or one whose header is damaged: start over
+        if (::ftruncate(fd, 0) != 0) {
+            LOG_ERROR << "Cannot truncate " << filename;
+        }
+        ::lseek(fd, 0, SEEK_SET);
+        size = 0;
+        if (!writeAll(kMagic, sizeof(kMagic))) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        size = sizeof(kMagic);
+    } else {
+        if (::ftruncate(fd, valid) != 0) {
+            LOG_ERROR << "Cannot truncate " << filename;
+        }
+        ::lseek(fd, valid, SEEK_SET);
+        size = valid;
+    }
+    sync();
+    return true;
+}
+
+bool WriteAheadLog::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return fd >= 0;
+}
+
+uint64_t WriteAheadLog::append(WalOp op, const string& text, uint32_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0) {
+        failedCount++;
+        return 0;
+    }
+    if (text.size() > kMaxText) {
+        LOG_ERROR << "Write-ahead log record of " << text.size() << " bytes is over the "
+                  << kMaxText << "-byte limit; not logged";
+        failedCount++;
+        return 0;
+    }
+    
+    uint64_t lsn = nextLsn;
+    uint32_t payloadSize = (uint32_t)(kPayloadFixed + text.size());
+    std::vector<char> record(kRecordHeader + payloadSize);
+    char* payload = record.data() + kRecordHeader;
+    uint8_t opByte = static_cast<uint8_t>(op);
+    std::memcpy(payload, &lsn, 8);
+    std::memcpy(payload + 8, &opByte, 1);
+    std::memcpy(payload + 9, &count, 4);
+    std::memcpy(payload + kPayloadFixed, text.data(), text.size());
+    uint32_t crc = crc32(payload, payloadSize);
+    std::memcpy(record.data(), &payloadSize, 4);
+    std::memcpy(record.data() + 4, &crc, 4);
+    
+    if (!writeAll(record.data(), record.size())) {
+        failedCount++;
+        return 0;
+    }
+    nextLsn++;
+    size += record.size();
+    dirty = true;
+    if (opts.sync == WalSync::EveryRecord) sync();
+    return lsn;
+}
+
+void WriteAheadLog::commit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0 || !dirty) return;
+    if (opts.sync == WalSync::GroupCommit ||
+        std::chrono::steady_clock::now() - lastSync >= opts.syncInterval) {
+        sync();
+    }
+}
+
+void WriteAheadLog::syncIfDue() {
+    commit();
+}
+
+bool WriteAheadLog::syncPending(std::chrono::steady_clock::time_point& at) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0 || !dirty) return false;
+    at = opts.sync == WalSync::Interval ? lastSync + opts.syncInterval
+                                        : std::chrono::steady_clock::now();
+    return true;
+}
+
+bool WriteAheadLog::rotate(const string& sealedPath, uint64_t& lastLsn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    lastLsn = nextLsn - 1;
+    if (fd < 0) return false;
+    if (dirty) sync();
+    // Renamed while still open: if the rename fails, nothing has changed
+    // and appends simply continue
+    if (std::rename(path.c_str(), sealedPath.c_str()) != 0) {
+        LOG_ERROR << "Cannot seal write-ahead log " << path << ": " << std::strerror(errno);
+        return false;
+    }
+    ::close(fd);
+    
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    size = 0;
+    if (fd >= 0 && writeAll(kMagic, sizeof(kMagic))) {
+        size = sizeof(kMagic);
+        sync();
+    } else {
+        // Records are counted as failed appends until a restart reopens it
+        LOG_ERROR << "Cannot reopen write-ahead log " << path;
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+    return true;
+}
+
+size_t WriteAheadLog::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return size;
+}
+
+uint64_t WriteAheadLog::lastLsn() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nextLsn - 1;
+}
+
+uint64_t WriteAheadLog::syncs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return syncCount;
+}
+
+uint64_t WriteAheadLog::failedAppends() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failedCount;
+}
+
+uint64_t WriteAheadLog::failedSyncs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failedSyncCount;
+}
+
+bool WriteAheadLog::writeAll(const void* data, size_t count) {
+    const char* p = static_cast<const char*>(data);
+    while (count > 0) {
+        ssize_t n = ::write(fd, p, count);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            LOG_ERROR << "Write-ahead log write failed: " << std::strerror(errno);
+            // Drop whatever part of the record made it, so the next record
+            // lands where replay expects it
+            if (::ftruncate(fd, size) != 0 || ::lseek(fd, size, SEEK_SET) < 0) {
+                LOG_ERROR << "Cannot cut back write-ahead log " << path;
+            }
+            return false;
+        }
+        p += n;
+        count -= (size_t)n;
+    }
+    return true;
+}
+
+void WriteAheadLog::sync() {
+    if (::fdatasync(fd) == 0) {
+        syncCount++;
+    } else {
+        LOG_ERROR << "Write-ahead log sync failed: " << std::strerror(errno);
+        failedSyncCount++;
+    }
+    dirty = false;
+    lastSync = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,568 @@
+// Dictionary build and traversal tests.
+// Checks that the bulk loaders produce exactly the trie that inserting the
+// same lines one at a time produces, that a counted insert matches repeated
+// inserts, that top-k collection, sequential or fork-join, returns the true
+// top k and counts its work on every call, that the word iterator visits every word in order, that the sorted
+// builder lays out the same trie in DFS order, that binary indexes and
+// front-coded files round-trip and are refused when damaged, that the
+// frequency-list parser matches a stream-based reference, and that memory
+// accounting counts what is there.
+#include "Checksum.h"
+#include "DictionaryLoader.h"
+#include "FrontCodedFile.h"
+#include "HistorySnapshot.h"
+#include "Log.h"
+#include "Probes.h"
+#include "SortedTrieBuilder.h"
+#include "TaskPool.h"
+#include "TrieIndex.h"
+#include "TrieNode.h"
+#include "Varint.h"
+#include "WordIterator.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " \
+                      << #cond << "\n";                                    \
+            ++failures;                                                    \
+        }                                                                  \
+    } while (0)
+
+// Random dictionary text with duplicates, CRLF endings, blank lines, letterless
+// lines and characters the trie skips
+static string syntheticText(int lines, unsigned seed) {
+    std::mt19937 rng(seed);
+    string text;
+    for (int i = 0; i < lines; ++i) {
+        switch (rng() % 50) {
+        case 0: text += "\n"; continue;
+        case 1: text += "1234\n"; continue;
+        case 2: text += "Don't-stop\r\n"; continue;
+        }
+        int len = 1 + rng() % 12;
+        for (int j = 0; j < len; ++j) text += char('a' + rng() % (j == 0 ? 26 : 6));
+        text += (rng() % 4 == 0) ? "\r\n" : "\n";
+    }
+    text += "trailing";   // no final newline
+    return text;
+}
+
+static void checkParallelMatchesSerial(const string& text, unsigned threads) {
+    TrieNode* serial = new TrieNode();
+    int serialLines = DictionaryLoader::loadLines(serial, text, 1);
+
+    TrieNode* parallel = new TrieNode();
+    int parallelLines = DictionaryLoader::loadLines(parallel, text, threads);
+
+    CHECK(serialLines == parallelLines);
+    CHECK(TrieNode::equalTree(serial, parallel));
+
+    // Loading on top of an existing trie extends it the same way
+    DictionaryLoader::loadLines(serial, text, 1);
+    DictionaryLoader::loadLines(parallel, text, threads);
+    CHECK(TrieNode::equalTree(serial, parallel));
+
+    TrieNode::destroyTree(serial);
+    TrieNode::destroyTree(parallel);
+}
+
+// Reference top-k: every word under the prefix, fully sorted
+static vector<pair<string, int>> bruteTopK(const string& text, const string& prefix, int k) {
+    std::map<string, int> counts;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = std::min(text.find('\n', pos), text.size());
+        string word;
+        for (char ch : text.substr(pos, end - pos))
+            if (ch >= 'a' && ch <= 'z') word += ch;
+        if (word.compare(0, prefix.size(), prefix) == 0) counts[word]++;
+        pos = end + 1;
+    }
+    vector<pair<string, int>> all(counts.begin(), counts.end());
+    std::sort(all.begin(), all.end(), [](const auto& a, const auto& b) {
+        if (a.second != b.second) return a.second > b.second;
+        return a.first < b.first;
+    });
+    if ((int)all.size() > k) all.resize(k);
+    return all;
+}
+
+static size_t countNodes(const TrieNode* node) {
+    if (!node) return 0;
+    size_t count = 1;
+    for (int i = 0; i < 26; ++i) count += countNodes(node->child(i));
+    return count;
+}
+
+// Collection returns the same words, visits every node below the prefix
+// once, and pops whatever it pushed; timing it changes only the times
+static void checkCollection(const string& text) {
+    TrieNode* root = new TrieNode();
+    DictionaryLoader::loadLines(root, text, 1);
+    TaskPool pool(4);
+    for (const string prefix : {"", "a", "ab", "f", "zzz"}) {
+        const TrieNode* below = root;
+        for (char ch : prefix) below = below ? below->child(ch - 'a') : nullptr;
+        for (int k : {1, 10, 1000}) {
+            auto expected = bruteTopK(text, prefix, k);
+            CHECK(root->getAllWithPrefix(prefix, k) == expected);
+            CHECK(root->getAllWithPrefix(prefix, k, &pool, 1) == expected);
+
+            CollectStats serial, parallel;
+            CHECK(root->getAllWithPrefix(prefix, k, nullptr, 0, &serial) == expected);
+            CHECK(root->getAllWithPrefix(prefix, k, &pool, 1, &parallel) == expected);
+            CHECK(serial.nodesVisited == countNodes(below));
+            CHECK(parallel.nodesVisited == serial.nodesVisited);
+            CHECK(serial.heapPushes >= expected.size() && serial.heapPops == serial.heapPushes);
+            CHECK(parallel.heapPops == parallel.heapPushes);
+            CHECK(!serial.parallel && parallel.parallel == (below != nullptr));
+            CHECK(serial.descentNs == 0 && serial.traversalNs == 0);
+
+            CollectStats timed;
+            CHECK(root->getAllWithPrefix(prefix, k, nullptr, 0, &timed, true) == expected);
+            CHECK(timed.nodesVisited == serial.nodesVisited && timed.heapPushes == serial.heapPushes);
+            CHECK(timed.traversalNs > 0 || !below);
+        }
+    }
+    TrieNode::destroyTree(root);
+}
+
+#if PROBES_ACTIVE
+// "provider:name" of every probe note in the ELF file at `path`
+static vector<string> probeNotes(const string& path) {
+    std::ifstream in(path, std::ios::binary);
+    string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    vector<string> probes;
+    if (image.size() < sizeof(Elf64_Ehdr)) return probes;
+    const auto* header = reinterpret_cast<const Elf64_Ehdr*>(image.data());
+    const auto* sections = reinterpret_cast<const Elf64_Shdr*>(image.data() + header->e_shoff);
+    const char* names = image.data() + sections[header->e_shstrndx].sh_offset;
+    for (int i = 0; i < header->e_shnum; ++i) {
+        if (string(names + sections[i].sh_name) != ".note.stapsdt") continue;
+        size_t at = sections[i].sh_offset;
+        size_t end = at + sections[i].sh_size;
+        while (at + sizeof(Elf64_Nhdr) <= end) {
+            const auto* note = reinterpret_cast<const Elf64_Nhdr*>(image.data() + at);
+            const char* desc = image.data() + at + sizeof(Elf64_Nhdr) + ((note->n_namesz + 3) & ~3u);
+            if (note->n_type == 3) {
+                // Three addresses, then provider and name
+                const char* provider = desc + 3 * sizeof(uint64_t);
+                const char* name = provider + strlen(provider) + 1;
+                probes.push_back(string(provider) + ":" + name);
+            }
+            at += sizeof(Elf64_Nhdr) + ((note->n_namesz + 3) & ~3u) + ((note->n_descsz + 3) & ~3u);
+        }
+    }
+    return probes;
+}
+#endif
+
+// The probes are in this very binary, and an attached collect__done (its
+// semaphore raised) does not change what is returned
+static void checkProbes(const string& text) {
+#if PROBES_ACTIVE
+    vector<string> probes = probeNotes("/proc/self/exe");
+    for (const char* name : {"autocomplete:collect__start", "autocomplete:collect__done"}) {
+        CHECK(std::find(probes.begin(), probes.end(), name) != probes.end());
+    }
+
+    TrieNode* root = new TrieNode();
+    DictionaryLoader::loadLines(root, text, 1);
+    auto expected = root->getAllWithPrefix("a", 10);
+    PROBE_SEMAPHORE(collect__done) = 1;
+    CHECK(root->getAllWithPrefix("a", 10) == expected);
+    PROBE_SEMAPHORE(collect__done) = 0;
+    TrieNode::destroyTree(root);
+#else
+    (void)text;
+#endif
+}
+
+// The iterator yields every word once, in lexicographic order
+static void checkWordIterator(const string& text) {
+    TrieNode* root = new TrieNode();
+    DictionaryLoader::loadLines(root, text, 1);
+    auto expected = bruteTopK(text, "", 1 << 30);
+    std::sort(expected.begin(), expected.end());
+
+    vector<pair<string, int>> walked;
+    for (WordIterator it(root); it.next();) walked.emplace_back(it.word(), it.frequency());
+    CHECK(walked == expected);
+
+    TrieNode::destroyTree(root);
+    WordIterator none(nullptr);
+    CHECK(!none.next());
+}
+
+// True if a pre-order walk meets the nodes at increasing addresses
+static bool preorderIsForward(const TrieNode* node, const TrieNode*& last) {
+    if (node <= last) return false;
+    last = node;
+    for (int i = 0; i < 26; ++i) {
+        if (const TrieNode* child = node->child(i)) {
+            if (!preorderIsForward(child, last)) return false;
+        }
+    }
+    return true;
+}
+
+static void checkSortedBuild(const string& text) {
+    // Sort the lines by the letters the trie keeps
+    vector<pair<string, string>> keyed;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = std::min(text.find('\n', pos), text.size());
+        string line = text.substr(pos, end - pos);
+        string key;
+        for (char ch : line) if (ch >= 'a' && ch <= 'z') key += ch;
+        keyed.emplace_back(key, line);
+        pos = end + 1;
+    }
+    std::stable_sort(keyed.begin(), keyed.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    string sorted;
+    for (const auto& entry : keyed) sorted += entry.second + "\n";
+
+    TrieNode* expected = new TrieNode();
+    int expectedLines = DictionaryLoader::loadLines(expected, sorted, 1);
+    int lines = -1;
+    TrieNode* built = DictionaryLoader::buildSorted(sorted, lines);
+    CHECK(built != nullptr);
+    if (built) {
+        CHECK(lines == expectedLines);
+        CHECK(TrieNode::equalTree(expected, built));
+        const TrieNode* last = nullptr;
+        CHECK(preorderIsForward(built, last));
+
+        // Later inserts add heap nodes next to the block's
+        built->insert("zzzzzzzzzzzz");
+        expected->insert("zzzzzzzzzzzz");
+        CHECK(TrieNode::equalTree(expected, built));
+        TrieNode::destroyTree(built);
+    }
+    TrieNode::destroyTree(expected);
+
+    // Unsorted input is left to the insertion loaders
+    if (keyed.size() > 1 && keyed.front().first != keyed.back().first) {
+        CHECK(DictionaryLoader::buildSorted(keyed.back().second + "\n" + sorted, lines) == nullptr);
+    }
+}
+
+static void rewriteByte(const string& path, long offset, char value) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset);
+    file.put(value);
+}
+
+// An index loads back into the same trie; damaged ones are refused
+static void checkIndex(const string& text) {
+    TrieNode* root = new TrieNode();
+    DictionaryLoader::loadLines(root, text, 1);
+    root->insert("apple", 1000000);
+    string path = "build/build_test.idx";
+    CHECK(TrieIndex::write(root, path));
+
+    size_t words = 0;
+    TrieNode* loaded = TrieIndex::load(path, words);
+    CHECK(loaded != nullptr);
+    if (loaded) {
+        CHECK(words == (size_t)root->wordCount);
+        CHECK(TrieNode::equalTree(root, loaded));
+        TrieNode::destroyTree(loaded);
+    }
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    long size = (long)in.tellg();
+    in.close();
+    LogLevel level = Log::level();
+    Log::setLevel(LogLevel::Off);   // the refusals are logged as errors
+    rewriteByte(path, size / 2, 0x7f);
+    CHECK(TrieIndex::load(path, words) == nullptr);
+    TrieIndex::write(root, path);
+    rewriteByte(path, 8, char(TrieIndex::kVersion + 1));
+    CHECK(TrieIndex::load(path, words) == nullptr);
+    TrieIndex::write(root, path);
+    std::ofstream(path, std::ios::binary | std::ios::app).put(0);
+    CHECK(TrieIndex::load(path, words) == nullptr);
+    Log::setLevel(level);
+
+    // No index is a normal startup, not an error
+    Log::setLevel(LogLevel::Info);
+    Log::flush();
+    uint64_t logged = Log::written();
+    CHECK(TrieIndex::load("build/missing.idx", words) == nullptr);
+    Log::flush();
+    CHECK(Log::written() == logged);
+    Log::setLevel(level);
+
+    std::remove(path.c_str());
+    TrieNode::destroyTree(root);
+}
+
+// The front-coded file rebuilds the same trie, each block decodes on its
+// own, and a damaged block is refused
+static void checkFrontCoded(const string& text) {
+    TrieNode* root = new TrieNode();
+    DictionaryLoader::loadLines(root, text, 1);
+    root->insert("apple", 1000000);
+    string path = "build/build_test.fc";
+    CHECK(FrontCodedFile::write(root, path));
+
+    FrontCodedFile dict;
+    CHECK(dict.open(path));
+    CHECK(dict.words() == (size_t)root->wordCount);
+    TrieNode* loaded = dict.build();
+    CHECK(loaded != nullptr);
+    if (loaded) {
+        CHECK(TrieNode::equalTree(root, loaded));
+        TrieNode::destroyTree(loaded);
+    }
+    size_t seen = 0;
+    for (WordIterator it(root); it.next(); ++seen) {
+        if (seen % 97 != 0) continue;
+        bool found = false;
+        dict.readBlock(dict.findBlock(it.word()), [&](std::string_view word, int freq) {
+            if (word == it.word()) found = freq == it.frequency();
+            return true;
+        });
+        CHECK(found);
+    }
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    long size = (long)in.tellg();
+    in.close();
+    LogLevel level = Log::level();
+    Log::setLevel(LogLevel::Off);
+    FrontCodedFile damaged;
+    if (root->wordCount > 0) {
+        rewriteByte(path, 48 + (size - 48) / 3, 0x7f);   // inside some block
+        CHECK(damaged.open(path));
+        CHECK(damaged.build() == nullptr);
+        FrontCodedFile::write(root, path);
+    }
+    std::ofstream(path, std::ios::binary | std::ios::app).put(0);
+    CHECK(!damaged.open(path));
+
+    // A count past INT_MAX is refused, not read back negative. The trie
+    // cannot hold one, so the file's one block is rewritten around it.
+    TrieNode* single = new TrieNode();
+    single->insert("apple", 1);
+    CHECK(FrontCodedFile::write(single, path));
+    TrieNode::destroyTree(single);
+    string file;
+    {
+        std::ifstream original(path, std::ios::binary);
+        file.assign(std::istreambuf_iterator<char>(original), std::istreambuf_iterator<char>());
+    }
+    const size_t kHeader = 48;
+    string block = string("\0\5apple", 7);
+    putVarint(block, uint64_t(INT_MAX) + 1);
+    uint64_t offset = kHeader;
+    uint32_t blockSize = (uint32_t)block.size(), blockCrc = crc32(block.data(), block.size());
+    string index(reinterpret_cast<const char*>(&offset), 8);
+    index.append(reinterpret_cast<const char*>(&blockSize), 4);
+    index.append(reinterpret_cast<const char*>(&blockCrc), 4);
+    uint32_t indexCrc = crc32(index.data(), index.size());
+    file = file.substr(0, kHeader) + block + index;
+    std::memcpy(&file[40], &indexCrc, 4);
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << file;
+    CHECK(damaged.open(path));
+    CHECK(!damaged.readBlock(0, [](std::string_view, int) { return true; }));
+    CHECK(damaged.build() == nullptr);
+    Log::setLevel(level);
+
+    SortedTrieBuilder builder(4);
+    CHECK(builder.add("ab", 1));
+    CHECK(!builder.add("aa", 1));   // out of order
+    CHECK(!builder.add("abcd", 1));   // over the counted nodes
+    CHECK(builder.add("abc", 1));
+
+    std::remove(path.c_str());
+    TrieNode::destroyTree(root);
+}
+
+// Random "word,frequency" lines, with commas inside words, missing or bad
+// counts, blanks, signs and CRLF endings, long enough to cross SIMD blocks
+static string syntheticFrequencies(int lines, unsigned seed) {
+    std::mt19937 rng(seed);
+    string text;
+    for (int i = 0; i < lines; ++i) {
+        int len = 1 + rng() % 30;
+        for (int j = 0; j < len; ++j) text += char('a' + rng() % 8);
+        switch (rng() % 12) {
+        case 0: text += "\n"; continue;                  // no comma
+        case 1: text += ",x7\n"; continue;               // no count
+        case 2: text += ",12,"; break;                   // commas in the word
+        case 3: text += ", "; break;
+        case 4: text += ",+"; break;
+        case 5: text += ",-"; break;
+        default: text += ","; break;
+        }
+        text += std::to_string(rng() % 100000);
+        text += (rng() % 4 == 0) ? "\r\n" : "\n";
+    }
+    text += "tail,42";   // no final newline
+    return text;
+}
+
+// loadFrequencies parses exactly like getline + rfind(',') + istream >> int
+static void checkFrequencies(const string& text) {
+    TrieNode* expected = new TrieNode();
+    int expectedLines = 0;
+    std::istringstream in(text);
+    string line;
+    while (getline(in, line)) {
+        size_t comma = line.rfind(',');
+        if (comma == string::npos) continue;
+        std::istringstream field(line.substr(comma + 1));
+        int freq;
+        if (field >> freq) {
+            expected->insert(line.substr(0, comma), freq);
+            expectedLines++;
+        }
+    }
+
+    TrieNode* loaded = new TrieNode();
+    CHECK(DictionaryLoader::loadFrequencies(loaded, text) == expectedLines);
+    CHECK(TrieNode::equalTree(expected, loaded));
+    TrieNode::destroyTree(expected);
+    TrieNode::destroyTree(loaded);
+}
+
+// A counted insert leaves the trie exactly as that many single inserts do
+static void checkCountedInsert() {
+    TrieNode* single = new TrieNode();
+    TrieNode* counted = new TrieNode();
+    for (auto entry : {pair<string, int>{"apple", 3}, {"app", 1000}, {"apple", 2},
+                       {"Don't", 4}, {"zebra", 0}, {"zebra", -5}}) {
+        for (int i = 0; i < entry.second; ++i) single->insert(entry.first);
+        counted->insert(entry.first, entry.second);
+    }
+    CHECK(TrieNode::equalTree(single, counted));
+    CHECK(!counted->search("zebra"));
+    CHECK(counted->getAllWithPrefix("app") ==
+          (vector<pair<string, int>>{{"app", 1000}, {"apple", 5}}));
+    TrieNode::destroyTree(single);
+    TrieNode::destroyTree(counted);
+}
+
+static void checkMemoryStats(const string& text) {
+    TrieNode* small = new TrieNode();
+    for (const char* word : {"a", "ab", "abc", "b"}) small->insert(word);
+    TrieMemoryStats stats = TrieNode::memoryStats(small);
+    CHECK(stats.nodes == 5 && stats.terminalNodes == 4 && stats.heapNodes == 5);
+    CHECK(stats.bytes == 5 * sizeof(TrieNode));
+    CHECK(stats.childLinks == 4 && stats.averageFanout == 4.0 / 3);
+    CHECK(stats.depthHistogram == (vector<size_t>{1, 2, 1, 1}));
+    TrieNode::destroyTree(small);
+    CHECK(TrieNode::memoryStats(nullptr).nodes == 0);
+
+    // A block-built trie is charged its whole mapping
+    TrieNode* built = new TrieNode();
+    DictionaryLoader::loadLines(built, text, 1);
+    TrieMemoryStats inserted = TrieNode::memoryStats(built);
+    auto words = bruteTopK(text, "", 1 << 30);
+    std::sort(words.begin(), words.end());
+    string sortedText;
+    for (const auto& word : words) sortedText += word.first + "\n";
+    int lines = 0;
+    TrieNode* sorted = DictionaryLoader::buildSorted(sortedText, lines);
+    TrieMemoryStats packed = TrieNode::memoryStats(sorted);
+    CHECK(packed.nodes == inserted.nodes && packed.heapNodes == 0);
+    CHECK(packed.bytes >= packed.nodes * sizeof(TrieNode));
+    CHECK(packed.depthHistogram == inserted.depthHistogram);
+    TrieNode::destroyTree(built);
+    TrieNode::destroyTree(sorted);
+
+    HistorySnapshot empty;
+    HistorySnapshot* hist = empty.withUpdates({{"apple", 1}, {"a-rather-long-user-word", 2}},
+                                              {{"ap", 3}});
+    HistoryMemoryStats user = hist->user.memoryStats();
+    CHECK(user.entries == 2 && user.keyBytes == 28);
+    CHECK(user.bytes > 2 * sizeof(string) + 24);   // the long key is stored out of line
+    CHECK(hist->search.memoryStats().entries == 1);
+    delete hist;
+}
+
+// Publishing a batch into a large history copies only what the batch
+// touches; the version it started from keeps its own counts
+static void checkHistoryPublish() {
+    const size_t kEntries = 200000;
+    vector<pair<string, int>> entries;
+    for (size_t i = 0; i < kEntries; ++i) entries.emplace_back("h" + std::to_string(i), 1);
+    HistorySnapshot empty;
+    std::unique_ptr<HistorySnapshot> large(empty.withUpdates(entries, entries));
+    CHECK(large->userSize == kEntries && large->searchSize == kEntries);
+    CHECK(large->userCount("h123") == 1 && large->searchCount("h199999") == 1);
+
+    vector<pair<string, int>> batch;
+    for (size_t i = 0; i < 64; ++i) batch.emplace_back("h" + std::to_string(i * 3001), 2);
+    batch.emplace_back("new", 5);
+    batch.emplace_back("new", 1);
+    std::unique_ptr<HistorySnapshot> next(large->withUpdates({}, batch));
+    CHECK(next->searchSize == kEntries + 1 && next->userSize == kEntries);
+    CHECK(next->searchCount("new") == 6 && next->searchCount("h3001") == 3);
+    CHECK(next->searchCount("h1") == 1 && next->searchCount("missing") == 0);
+    CHECK(large->searchCount("h3001") == 1 && large->searchCount("new") == 0);
+
+    size_t copied = next->search.entriesNotSharedWith(large->search);
+    CHECK(copied > 0 && copied <= batch.size() * (PersistentCountMap::kLeafCapacity + 1));
+    CHECK(next->user.entriesNotSharedWith(large->user) == 0);
+    size_t seen = 0;
+    long total = 0;
+    next->search.forEach([&](const string&, int count) {
+        seen++;
+        total += count;
+    });
+    CHECK(seen == kEntries + 1 && total == long(kEntries) + 64 * 2 + 6);
+}
+
+int main() {
+    string text = syntheticText(50000, 1);
+    for (unsigned threads : {2u, 3u, 8u, 64u}) {
+        checkParallelMatchesSerial(text, threads);
+    }
+    checkParallelMatchesSerial("", 4);
+    checkParallelMatchesSerial("\n\n", 4);
+    checkParallelMatchesSerial("a", 4);
+    checkCollection(syntheticText(20000, 2));
+    checkProbes(syntheticText(2000, 2));
+    checkWordIterator(syntheticText(20000, 3));
+    checkWordIterator("");
+    checkCountedInsert();
+    checkMemoryStats(syntheticText(5000, 8));
+    checkHistoryPublish();
+    checkSortedBuild(syntheticText(20000, 5));
+    checkSortedBuild("");
+    checkSortedBuild("a\na\nab\n");
+    checkIndex(syntheticText(20000, 6));
+    checkIndex("");
+    checkFrontCoded(syntheticText(20000, 7));
+    checkFrontCoded("");
+    checkFrequencies(syntheticFrequencies(20000, 4));
+    checkFrequencies("");
+    checkFrequencies(",5");
+
+    if (failures) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "build_test: OK\n";
+    return 0;
+}
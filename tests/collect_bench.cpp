@@ -0,0 +1,72 @@
+// Top-k collection benchmark.
+// Compares sequential and fork-join getAllWithPrefix latency on a synthetic
+// dictionary for prefixes of different sizes, and full collection over the
+// insertion-built node layout against the sorted builder's.
+#include "DictionaryLoader.h"
+#include "TaskPool.h"
+#include "TrieNode.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+template <typename F>
+static double averageMicros(int runs, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) f();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main(int argc, char** argv) {
+    int lines = argc > 1 ? std::stoi(argv[1]) : 1000000;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::mt19937 rng(5);
+    string text;
+    for (int i = 0; i < lines; ++i) {
+        int len = 3 + rng() % 10;
+        for (int j = 0; j < len; ++j) text += char('a' + rng() % 26);
+        text += '\n';
+    }
+    TrieNode* root = new TrieNode();
+    DictionaryLoader::loadLines(root, text);
+    TaskPool pool(threads);
+
+    std::cout << "prefix,k,words,sequential_us,parallel_us\n";
+    for (const string prefix : {"", "a", "ab", "abc"}) {
+        for (int k : {10, 1000}) {
+            int runs = prefix.size() < 2 ? 5 : 200;
+            double seq = averageMicros(runs, [&] { root->getAllWithPrefix(prefix, k); });
+            double par = averageMicros(runs, [&] { root->getAllWithPrefix(prefix, k, &pool, 1); });
+            const TrieNode* node = root;
+            for (char ch : prefix) node = node ? node->child(ch - 'a') : nullptr;
+            std::cout << "'" << prefix << "'," << k << "," << (node ? node->wordCount.load() : 0) << ","
+                      << seq << "," << par << "\n";
+        }
+    }
+
+    // Full-dictionary collection over the insertion-built layout versus the
+    // sorted builder's DFS-ordered block
+    vector<string> words;
+    for (size_t pos = 0; pos < text.size();) {
+        size_t end = text.find('\n', pos);
+        words.push_back(text.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    std::sort(words.begin(), words.end());
+    string sorted;
+    for (const string& word : words) sorted += word + "\n";
+    int count;
+    TrieNode* packed = DictionaryLoader::buildSorted(sorted, count);
+
+    std::cout << "layout,k,sequential_us\n";
+    for (int k : {10, 1000}) {
+        std::cout << "inserted," << k << "," << averageMicros(5, [&] { root->getAllWithPrefix("", k); }) << "\n";
+        std::cout << "dfs_block," << k << "," << averageMicros(5, [&] { packed->getAllWithPrefix("", k); }) << "\n";
+    }
+    TrieNode::destroyTree(packed);
+    TrieNode::destroyTree(root);
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Concurrent insert benchmark.
+// Inserts distinct words into one shared TrieNode from 1 up to all cores and
+// prints inserts per second for each thread count.
+#include "TrieNode.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+int main(int argc, char** argv) {
+    int wordsPerThread = argc > 1 ? std::stoi(argv[1]) : 200000;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "threads,inserts_per_sec\n";
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        vector<vector<string>> words(threads);
+        for (unsigned t = 0; t < threads; ++t) {
+            std::mt19937 rng(t);
+            for (int i = 0; i < wordsPerThread; ++i) {
+                string w;
+                int len = 4 + rng() % 8;
+                for (int j = 0; j < len; ++j) w += char('a' + rng() % 26);
+                words[t].push_back(w);
+            }
+        }
+
+        TrieNode* root = new TrieNode();
+        auto start = std::chrono::steady_clock::now();
+        vector<std::thread> writers;
+        for (unsigned t = 0; t < threads; ++t) {
+            writers.emplace_back([&, t] {
+                for (const string& w : words[t]) root->insert(w);
+            });
+        }
+        for (auto& w : writers) w.join();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << threads << "," << (long)(threads * wordsPerThread / secs) << "\n";
+        TrieNode::destroyTree(root);
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Suggest tail-latency benchmark for Trie.
+// Measures autoCompleteSystem latency percentiles on one reader thread,
+// first alone and then alongside writer threads that record searches and
+// add user words as fast as they can. Also times what the server's latency
+// middleware adds to each request.
+#include "Log.h"
+#include "RequestMetrics.h"
+#include "Trie.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static vector<double> measure(Trie& trie, int samples) {
+    vector<double> micros;
+    micros.reserve(samples);
+    string prefix = "aa";
+    for (int i = 0; i < samples; ++i) {
+        prefix[0] = char('a' + i % 26);
+        prefix[1] = char('a' + (i / 26) % 26);
+        auto start = Clock::now();
+        trie.autoCompleteSystem(prefix);
+        micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::sort(micros.begin(), micros.end());
+    return micros;
+}
+
+// What LatencyMiddleware does per request: two clock reads, a route lookup
+// and a record, on `threads` threads at once
+static double recordCost(int threads) {
+    const int kRequests = 1000000;
+    RequestMetrics metrics({"/api/health", "/api/suggest", "/api/search", "/api/userword",
+                            "/api/debug/ingest", "/api/export", "/api/admin/reload",
+                            "/api/metrics"});
+    const string path = "/api/userword";
+    auto start = Clock::now();
+    vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < kRequests; ++i) {
+                auto begin = Clock::now();
+                uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - begin).count();
+                metrics.record(metrics.route(path), 200, ns);
+            }
+        });
+    }
+    for (auto& th : workers) th.join();
+    // Core time per request, counting only the cores the threads could use
+    double cores = std::min<double>(threads, std::max(1u, std::thread::hardware_concurrency()));
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() * cores /
+           (double(threads) * kRequests);
+}
+
+static double percentile(const vector<double>& sorted, double p) {
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+int main(int argc, char** argv) {
+    int writers = argc > 1 ? std::stoi(argv[1]) : 4;
+    int samples = argc > 2 ? std::stoi(argv[2]) : 5000;
+
+    std::ostream report(std::cout.rdbuf());
+    Log::setLevel(LogLevel::Warn);  // silence the Trie's progress lines
+
+    Trie trie;
+    std::mt19937 rng(7);
+    for (int i = 0; i < 200000; ++i) {
+        string w;
+        int len = 3 + rng() % 8;
+        for (int j = 0; j < len; ++j) w += char('a' + rng() % 26);
+        trie.insert(w);
+    }
+
+    report << "writers,p50_us,p90_us,p99_us,max_us\n";
+    for (int w : {0, writers}) {
+        std::atomic<bool> stop{false};
+        vector<std::thread> threads;
+        for (int t = 0; t < w; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; !stop; ++i) {
+                    string word = "load" + string(1, char('a' + t)) + string(1, char('a' + i % 26));
+                    if (i % 2) trie.recordCompleteSearch(word);
+                    else trie.insertUserWord(word);
+                }
+            });
+        }
+        auto sorted = measure(trie, samples);
+        stop = true;
+        for (auto& th : threads) th.join();
+
+        report << w << "," << percentile(sorted, 0.50) << "," << percentile(sorted, 0.90) << ","
+               << percentile(sorted, 0.99) << "," << sorted.back() << "\n";
+    }
+
+    report << "\nmetrics_threads,record_ns\n";
+    for (int t : {1, writers}) report << t << "," << recordCost(t) << "\n";
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Dictionary load benchmark.
+// Times DictionaryLoader::loadLines on a synthetic word list from one thread
+// up to all cores, then the sorted builder against insertion, then
+// loadFrequencies on a "word,frequency" list against
+// the getline + istringstream loop it replaced, then the size and load time
+// of that dictionary saved as text and as a front-coded file, and the same
+// for a user history in text and binary.
+#include "DictionaryLoader.h"
+#include "FrontCodedFile.h"
+#include "HistoryFile.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Trie.h"
+#include "TrieNode.h"
+#include "WordIterator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+int main(int argc, char** argv) {
+    int lines = argc > 1 ? std::stoi(argv[1]) : 1000000;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::mt19937 rng(3);
+    string text;
+    for (int i = 0; i < lines; ++i) {
+        int len = 3 + rng() % 10;
+        for (int j = 0; j < len; ++j) text += char('a' + rng() % 26);
+        text += '\n';
+    }
+
+    std::cout << "threads,load_ms\n";
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        TrieNode* root = new TrieNode();
+        auto start = std::chrono::steady_clock::now();
+        DictionaryLoader::loadLines(root, text, threads);
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << threads << "," << ms << "\n";
+        TrieNode::destroyTree(root);
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+
+    // The same words sorted: insertion versus the one-pass sorted build
+    vector<string> words;
+    for (size_t pos = 0; pos < text.size();) {
+        size_t end = text.find('\n', pos);
+        words.push_back(text.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    std::sort(words.begin(), words.end());
+    string sorted;
+    for (const string& word : words) sorted += word + "\n";
+
+    std::cout << "sorted_builder,load_ms\n";
+    {
+        TrieNode* root = new TrieNode();
+        auto start = std::chrono::steady_clock::now();
+        DictionaryLoader::loadLines(root, sorted, 1);
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "insert," << ms << "\n";
+        TrieNode::destroyTree(root);
+    }
+    {
+        int count;
+        auto start = std::chrono::steady_clock::now();
+        TrieNode* root = DictionaryLoader::buildSorted(sorted, count);
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "build_sorted," << ms << "\n";
+        TrieNode::destroyTree(root);
+    }
+
+    string freqText;
+    for (int i = 0; i < lines; ++i) {
+        int len = 3 + rng() % 10;
+        for (int j = 0; j < len; ++j) freqText += char('a' + rng() % 26);
+        freqText += ',';
+        freqText += std::to_string(rng() % 1000000);
+        freqText += '\n';
+    }
+
+    std::cout << "frequency_parser,load_ms\n";
+    {
+        TrieNode* root = new TrieNode();
+        auto start = std::chrono::steady_clock::now();
+        std::istringstream in(freqText);
+        string line;
+        while (getline(in, line)) {
+            size_t comma = line.rfind(',');
+            if (comma == string::npos) continue;
+            std::istringstream field(line.substr(comma + 1));
+            int freq;
+            if (field >> freq) root->insert(line.substr(0, comma), freq);
+        }
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "istream," << ms << "\n";
+        TrieNode::destroyTree(root);
+    }
+    {
+        TrieNode* root = new TrieNode();
+        auto start = std::chrono::steady_clock::now();
+        DictionaryLoader::loadFrequencies(root, freqText);
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "simd," << ms << "\n";
+        TrieNode::destroyTree(root);
+    }
+    {
+        // The inserts alone; subtract from the rows above for parse time
+        vector<pair<string, int>> entries;
+        std::istringstream in(freqText);
+        string line;
+        while (getline(in, line)) {
+            size_t comma = line.rfind(',');
+            entries.emplace_back(line.substr(0, comma), std::stoi(line.substr(comma + 1)));
+        }
+        TrieNode* root = new TrieNode();
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& entry : entries) root->insert(entry.first, entry.second);
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "insert_only," << ms << "\n";
+        TrieNode::destroyTree(root);
+    }
+
+    // The same dictionary saved as text and front-coded, then loaded back
+    TrieNode* dict = new TrieNode();
+    DictionaryLoader::loadFrequencies(dict, freqText);
+    string textFile = "build/load_bench.txt";
+    string codedFile = "build/load_bench.fc";
+    {
+        std::ofstream out(textFile, std::ios::binary);
+        for (WordIterator it(dict); it.next();) out << it.word() << ',' << it.frequency() << '\n';
+    }
+    FrontCodedFile::write(dict, codedFile);
+    TrieNode::destroyTree(dict);
+
+    std::cout << "dictionary_file,bytes,load_ms\n";
+    {
+        auto start = std::chrono::steady_clock::now();
+        MappedFile file;
+        file.open(textFile);
+        TrieNode* root = new TrieNode();
+        DictionaryLoader::loadFrequencies(root, file.text());
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "text," << file.text().size() << "," << ms << "\n";
+        TrieNode::destroyTree(root);
+    }
+    {
+        auto start = std::chrono::steady_clock::now();
+        FrontCodedFile file;
+        file.open(codedFile);
+        TrieNode* root = file.build();
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::ifstream in(codedFile, std::ios::binary | std::ios::ate);
+        std::cout << "front_coded," << in.tellg() << "," << ms << "\n";
+        TrieNode::destroyTree(root);
+
+        // Decoding alone; the rest of the row above is node allocation
+        start = std::chrono::steady_clock::now();
+        size_t letters = 0;
+        for (size_t i = 0; i < file.blocks(); ++i) {
+            file.readBlock(i, [&letters](std::string_view word, int) {
+                letters += word.size();
+                return true;
+            });
+        }
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "decode_only," << in.tellg() << "," << ms << (letters ? "\n" : " (empty)\n");
+    }
+    std::remove(textFile.c_str());
+    std::remove(codedFile.c_str());
+
+    // A user history of `lines` entries per section, loaded from each format
+    vector<pair<string, int>> entries;
+    for (int i = 0; i < lines; ++i) entries.emplace_back(words[i], 1 + rng() % 1000);
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const auto& a, const auto& b) { return a.first == b.first; }),
+                  entries.end());
+    HistorySnapshot empty;
+    std::unique_ptr<HistorySnapshot> history(empty.withUpdates(entries, entries));
+    string historyText = "build/load_bench_history.txt";
+    string historyBinary = "build/load_bench_history.bin";
+    HistoryFile::writeText(historyText, history->user, history->search, 0);
+    HistoryFile::write(historyBinary, history->user, history->search, 0);
+
+    std::cout << "user_history,bytes,read_ms,load_ms\n";
+    for (const string& file : {historyText, historyBinary}) {
+        std::ifstream in(file, std::ios::binary | std::ios::ate);
+        auto start = std::chrono::steady_clock::now();
+        uint64_t checkpoint;
+        size_t seen = 0;
+        HistoryFile::read(file, checkpoint, [&seen](HistoryFile::Section, std::string_view, int) {
+            seen++;
+        });
+        auto readMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        {
+            Trie trie;
+            Log::setLevel(LogLevel::Warn);
+            start = std::chrono::steady_clock::now();
+            trie.loadUserHistory(file);
+            auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            Log::setLevel(LogLevel::Info);
+            std::cout << (file == historyText ? "text," : "binary,") << in.tellg() << ","
+                      << readMs << "," << ms << "\n";
+        }
+        std::remove(file.c_str());
+    }
+    return 0;
+}
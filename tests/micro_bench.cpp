@@ -0,0 +1,370 @@
+// Microbenchmark suite.
+// Times the core operations one at a time: TrieNode::insert, search hits and
+// misses, getAllWithPrefix for prefixes of 0 to 3 letters,
+// Trie::autoCompleteSystem, the dictionary and history load/save paths, and
+// publishing a batch of history counts.
+// Runs on a synthetic dictionary and, when the word list is present (or
+// --dict names one), on that too. Prints a CSV table and writes every result
+// as JSON (default build/bench.json) so runs from two commits can be compared;
+// --baseline reads an earlier JSON file and adds its numbers to the table.
+//
+//     micro_bench [--words N] [--dict PATH] [--out FILE] [--commit ID]
+//                 [--baseline FILE] [--min-ms MS]
+#include "crow/json.h"
+#include "HistoryFile.h"
+#include "HistorySnapshot.h"
+#include "Log.h"
+#include "Trie.h"
+#include "TrieIndex.h"
+#include "TrieNode.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+struct Dataset {
+    string name;
+    string path;                      // empty for the synthetic one
+    vector<pair<string, int>> words;  // distinct, in random order
+};
+
+struct Result {
+    string name;
+    string dataset;
+    size_t ops;      // operations per timed call
+    size_t calls;
+    double nsPerOp;  // median over the calls
+    double minNsPerOp;
+    double p90NsPerOp;
+};
+
+static vector<Result> results;
+static double minSampleMs = 300;
+static volatile size_t sink;
+
+// Runs body() (which performs `ops` operations) after one warm-up call until
+// at least minSampleMs have been timed and five calls made. setup and
+// teardown run around every call, outside the timing.
+static void measure(const string& name, const Dataset& data, size_t ops,
+                    const std::function<void()>& body,
+                    const std::function<void()>& setup = {},
+                    const std::function<void()>& teardown = {}) {
+    const size_t kMinCalls = 5, kMaxCalls = 10000;
+    vector<double> samples;
+    double timedMs = 0;
+    for (size_t call = 0; call <= kMaxCalls; ++call) {
+        if (setup) setup();
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (teardown) teardown();
+        if (call == 0) continue;
+        samples.push_back(ns / ops);
+        timedMs += ns / 1e6;
+        if (samples.size() >= kMinCalls && timedMs >= minSampleMs) break;
+    }
+    std::sort(samples.begin(), samples.end());
+    results.push_back({name, data.name, ops, samples.size(), samples[samples.size() / 2],
+                       samples.front(), samples[samples.size() * 9 / 10]});
+    const Result& r = results.back();
+    std::cout << r.name << "," << r.dataset << "," << r.nsPerOp << "," << r.minNsPerOp << ","
+              << r.p90NsPerOp << std::endl;
+}
+
+static Dataset synthetic(size_t count) {
+    Dataset data;
+    data.name = "synthetic";
+    std::mt19937 rng(5);
+    std::unordered_set<string> seen;
+    while (data.words.size() < count) {
+        string word;
+        int len = 3 + rng() % 10;
+        for (int j = 0; j < len; ++j) word += char('a' + rng() % 26);
+        if (!seen.insert(word).second) continue;
+        // Roughly Zipfian, so a few words dominate each prefix as in real use
+        data.words.emplace_back(word, int(1 + 1000000 / (data.words.size() + 1)));
+    }
+    std::shuffle(data.words.begin(), data.words.end(), rng);
+    return data;
+}
+
+// One word per line, optionally "word,frequency"; false if it cannot be read
+static bool fromFile(const string& path, Dataset& data) {
+    std::ifstream in(path);
+    if (!in) return false;
+    data.path = path;
+    data.name = path.substr(path.find_last_of('/') + 1);
+    data.name = data.name.substr(0, data.name.find('.'));
+    std::unordered_set<string> seen;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        int freq = 1;
+        size_t comma = line.rfind(',');
+        if (comma != string::npos) {
+            freq = std::atoi(line.c_str() + comma + 1);
+            line.resize(comma);
+        }
+        if (line.empty() || !seen.insert(line).second) continue;
+        data.words.emplace_back(line, std::max(freq, 1));
+    }
+    std::mt19937 rng(5);
+    std::shuffle(data.words.begin(), data.words.end(), rng);
+    return !data.words.empty();
+}
+
+// Up to `count` distinct prefixes of exactly `len` letters, taken from words
+static vector<string> prefixes(const Dataset& data, size_t len, size_t count) {
+    vector<string> out;
+    std::unordered_set<string> seen;
+    for (const auto& entry : data.words) {
+        if (out.size() == count) break;
+        if (entry.first.size() < len) continue;
+        string prefix = entry.first.substr(0, len);
+        if (seen.insert(prefix).second) out.push_back(prefix);
+    }
+    return out;
+}
+
+static void run(const Dataset& data) {
+    const size_t n = data.words.size();
+    const string base = "build/micro_bench_" + data.name;
+    std::mt19937 rng(7);
+
+    {
+        TrieNode* root = nullptr;
+        measure("trienode_insert", data, n, [&] {
+            for (const auto& entry : data.words) root->insert(entry.first, entry.second);
+        }, [&] { root = new TrieNode(); }, [&] { TrieNode::destroyTree(root); });
+    }
+
+    TrieNode* root = new TrieNode();
+    for (const auto& entry : data.words) root->insert(entry.first, entry.second);
+
+    vector<string> hits, misses;
+    for (size_t i = 0; i < 20000; ++i) {
+        const string& word = data.words[rng() % n].first;
+        hits.push_back(word);
+        // Shares its path with a word, so the miss costs a full descent
+        misses.push_back(word + char('a' + rng() % 26) + "#");
+    }
+    for (auto* queries : {&hits, &misses}) {
+        measure(queries == &hits ? "trienode_search_hit" : "trienode_search_miss", data,
+                queries->size(), [&] {
+            size_t found = 0;
+            for (const string& word : *queries) found += root->search(word);
+            sink = found;
+        });
+    }
+
+    const size_t prefixCounts[] = {1, 26, 300, 1000};
+    for (size_t len = 0; len <= 3; ++len) {
+        vector<string> set = prefixes(data, len, prefixCounts[len]);
+        measure("trienode_get_all_with_prefix_len" + std::to_string(len), data, set.size(), [&] {
+            size_t returned = 0;
+            for (const string& prefix : set) returned += root->getAllWithPrefix(prefix, 10).size();
+            sink = returned;
+        });
+    }
+
+    // The dictionary in every file format the server reads
+    const string textFile = base + ".txt", sortedFile = base + ".sorted",
+                 codedFile = base + ".fc", indexFile = base + ".idx",
+                 historyFile = base + ".history";
+    {
+        vector<pair<string, int>> sorted = data.words;
+        std::sort(sorted.begin(), sorted.end());
+        std::ofstream text(textFile), plain(sortedFile);
+        for (const auto& entry : sorted) {
+            text << entry.first << ',' << entry.second << '\n';
+            plain << entry.first << '\n';
+        }
+    }
+
+    {
+        Trie trie;
+        trie.loadFromFile(textFile);
+        // A few hundred user words so suggestions merge both tries
+        for (size_t i = 0; i < 500; ++i) trie.insertUserWord(data.words[rng() % n].first);
+        vector<string> queries;
+        for (size_t i = 0; i < 1000; ++i) {
+            const string& word = data.words[rng() % n].first;
+            queries.push_back(word.substr(0, 1 + rng() % std::min<size_t>(word.size(), 4)));
+        }
+        measure("trie_autocomplete_system", data, queries.size(), [&] {
+            size_t returned = 0;
+            for (const string& prefix : queries) returned += trie.autoCompleteSystem(prefix).size();
+            sink = returned;
+        });
+
+        measure("trie_save_front_coded", data, n, [&] { trie.saveToFile(codedFile); });
+    }
+
+    std::unique_ptr<Trie> fresh;
+    auto makeTrie = [&] { fresh.reset(new Trie()); };
+    auto dropTrie = [&] { fresh.reset(); };
+    measure("trie_load_text", data, n, [&] { fresh->loadFromFile(textFile); }, makeTrie, dropTrie);
+    measure("trie_load_front_coded", data, n, [&] { fresh->loadFromFile(codedFile); },
+            makeTrie, dropTrie);
+    measure("trie_build_sorted", data, n, [&] { sink = fresh->buildFromSorted(sortedFile); },
+            makeTrie, dropTrie);
+    measure("trie_index_write", data, n, [&] { sink = TrieIndex::write(root, indexFile); });
+    measure("trie_load_index", data, n, [&] { sink = fresh->loadIndex(indexFile); },
+            makeTrie, dropTrie);
+
+    // A user history with an entry per dictionary word in each section
+    {
+        vector<pair<string, int>> entries = data.words;
+        std::sort(entries.begin(), entries.end());
+        HistorySnapshot empty;
+        std::unique_ptr<HistorySnapshot> history(empty.withUpdates(entries, entries));
+        HistoryFile::write(historyFile, history->user, history->search, 0);
+    }
+    {
+        // One aggregator batch of 64 search counts published into a history
+        // of that size, as a prefix merge does; per key in the batch
+        vector<pair<string, int>> entries = data.words;
+        HistorySnapshot empty;
+        std::unique_ptr<HistorySnapshot> history(empty.withUpdates(entries, entries));
+        vector<pair<string, int>> batch;
+        for (size_t i = 0; i < 64; ++i) batch.emplace_back(entries[i * 7919 % n].first, 1);
+        measure("history_publish_batch", data, batch.size(), [&] {
+            std::unique_ptr<HistorySnapshot> next(history->withUpdates({}, batch));
+            sink = next->searchSize;
+        });
+    }
+    measure("trie_load_user_history", data, 2 * n, [&] { fresh->loadUserHistory(historyFile); },
+            makeTrie, dropTrie);
+    {
+        Trie trie;
+        trie.loadUserHistory(historyFile);
+        measure("trie_save_user_history", data, 2 * n, [&] { trie.saveUserHistory(historyFile); });
+    }
+
+    TrieNode::destroyTree(root);
+    for (const string& file : {textFile, sortedFile, codedFile, indexFile, historyFile}) {
+        std::remove(file.c_str());
+    }
+}
+
+static string quoted(const string& text) {
+    string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out += c;
+    }
+    return out + "\"";
+}
+
+static bool writeJson(const string& path, const string& commit, const vector<Dataset>& datasets) {
+    std::ostringstream out;
+    out << "{\n  \"commit\": " << quoted(commit) << ",\n"
+        << "  \"unix_time\": " << std::time(nullptr) << ",\n"
+        << "  \"compiler\": " << quoted(__VERSION__) << ",\n"
+        << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"datasets\": [";
+    for (size_t i = 0; i < datasets.size(); ++i) {
+        out << (i ? ",\n" : "\n") << "    {\"name\": " << quoted(datasets[i].name)
+            << ", \"path\": " << quoted(datasets[i].path)
+            << ", \"words\": " << datasets[i].words.size() << "}";
+    }
+    out << "\n  ],\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": " << quoted(r.name)
+            << ", \"dataset\": " << quoted(r.dataset) << ", \"ops_per_call\": " << r.ops
+            << ", \"calls\": " << r.calls << ", \"ns_per_op\": " << r.nsPerOp
+            << ", \"min_ns_per_op\": " << r.minNsPerOp << ", \"p90_ns_per_op\": " << r.p90NsPerOp
+            << "}";
+    }
+    out << "\n  ]\n}\n";
+    std::ofstream file(path);
+    file << out.str();
+    return bool(file);
+}
+
+// (name, dataset) -> ns_per_op from an earlier run's JSON
+static bool readBaseline(const string& path, std::map<pair<string, string>, double>& baseline,
+                         string& commit) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::stringstream text;
+    text << in.rdbuf();
+    crow::json::rvalue json = crow::json::load(text.str());
+    if (!json || !json.has("results")) return false;
+    if (json.has("commit")) commit = string(json["commit"].s());
+    for (const auto& r : json["results"]) {
+        baseline[{string(r["name"].s()), string(r["dataset"].s())}] = r["ns_per_op"].d();
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t words = 200000;
+    string dict = "src/dictionary/words_alpha.txt";
+    string out = "build/bench.json";
+    string commit = "unknown";
+    string baselinePath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "--words") words = std::stoul(value);
+        else if (flag == "--dict") dict = value;
+        else if (flag == "--out") out = value;
+        else if (flag == "--commit") commit = value;
+        else if (flag == "--baseline") baselinePath = value;
+        else if (flag == "--min-ms") minSampleMs = std::stod(value);
+        else {
+            std::cerr << "unknown option " << flag << "\n";
+            return 1;
+        }
+    }
+    if (words == 0) words = 1;
+
+    std::map<pair<string, string>, double> baseline;
+    string baselineCommit = "baseline";
+    if (!baselinePath.empty() && !readBaseline(baselinePath, baseline, baselineCommit)) {
+        std::cerr << "cannot read baseline " << baselinePath << "\n";
+        return 1;
+    }
+
+    // The loads log a line each; keep the table readable
+    Log::setLevel(LogLevel::Warn);
+
+    vector<Dataset> datasets;
+    datasets.push_back(synthetic(words));
+    Dataset real;
+    if (fromFile(dict, real)) datasets.push_back(std::move(real));
+    else std::cerr << "no word list at " << dict << "; synthetic dictionary only\n";
+
+    std::cout << "name,dataset,ns_per_op,min_ns_per_op,p90_ns_per_op\n";
+    for (const Dataset& data : datasets) run(data);
+
+    if (!baseline.empty()) {
+        std::cout << "name,dataset," << baselineCommit << "_ns_per_op," << commit
+                  << "_ns_per_op,change_percent\n";
+        for (const Result& r : results) {
+            auto it = baseline.find({r.name, r.dataset});
+            if (it == baseline.end() || it->second <= 0) continue;
+            std::cout << r.name << "," << r.dataset << "," << it->second << "," << r.nsPerOp << ","
+                      << 100 * (r.nsPerOp / it->second - 1) << "\n";
+        }
+    }
+
+    if (!writeJson(out, commit, datasets)) {
+        std::cerr << "cannot write " << out << "\n";
+        return 1;
+    }
+    std::cerr << "results written to " << out << "\n";
+    return 0;
+}
@@ -0,0 +1,455 @@
+// User-history durability tests.
+// Checks that the history survives a restart through the snapshot plus the
+// write-ahead log, that a torn log tail is dropped, that the background
+// snapshotter compacts on size and on time, and that compaction and an
+// interrupted compaction never lose or double-count a record, that the
+// sealed log outlives the unsynced snapshot, that a failed
+// log write or rotation loses nothing already logged, and that
+// binary and text history snapshots convert both ways while a damaged one is
+// refused. Also covers the dictionary's save/load round trip.
+#include "HistoryFile.h"
+#include "Log.h"
+#include "Trie.h"
+#include "WriteAheadLog.h"
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " \
+                      << #cond << "\n";                                    \
+            ++failures;                                                    \
+        }                                                                  \
+    } while (0)
+
+static string dir;
+
+static string snapshotFile() { return dir + "/history.txt"; }
+static string walFile() { return dir + "/history.wal"; }
+
+static void removeFiles() {
+    for (const string& file : {snapshotFile(), walFile(), walFile() + ".old"}) {
+        std::remove(file.c_str());
+    }
+}
+
+static size_t fileSize(const string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return in ? (size_t)in.tellg() : 0;
+}
+
+// Opens the history, applies a few events and shuts down without compacting
+static void writeSome(const WalOptions& options) {
+    Trie trie;
+    CHECK(trie.openHistoryLog(snapshotFile(), walFile(), options));
+    for (int i = 0; i < 3; ++i) trie.submitCompleteSearch("apple");
+    trie.submitUserWord("banana");
+    trie.submitUserWord("banana");
+    trie.autoCompleteSystem("ap");
+    trie.flushEvents();
+}
+
+static void checkCounts(Trie& trie, int scale) {
+    CHECK(trie.searchCount("apple") == 30 * scale);
+    CHECK(trie.userCount("apple") == 30 * scale);
+    CHECK(trie.userCount("banana") == 2 * scale);
+    CHECK(trie.searchCount("ap") == 1 * scale);
+}
+
+static void checkReplay() {
+    removeFiles();
+    for (WalSync sync : {WalSync::EveryRecord, WalSync::GroupCommit, WalSync::Interval}) {
+        WalOptions options;
+        options.sync = sync;
+        writeSome(options);
+    }
+    CHECK(fileSize(snapshotFile()) == 0);   // everything is still in the log
+
+    Trie trie;
+    CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+    checkCounts(trie, 3);
+    CHECK(trie.search("apple") == false);   // user words go to the user trie only
+}
+
+static void checkTornTail() {
+    removeFiles();
+    writeSome(WalOptions());
+    size_t intact = fileSize(walFile());
+    {
+        // A crash halfway through an append
+        std::ofstream out(walFile(), std::ios::binary | std::ios::app);
+        out.write("\x20\x00\x00\x00garbage", 11);
+    }
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        checkCounts(trie, 1);
+        CHECK(fileSize(walFile()) == intact);
+        trie.submitUserWord("banana");
+        trie.flushEvents();
+    }
+    Trie trie;
+    CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+    CHECK(trie.userCount("banana") == 3);
+}
+
+static void checkCompaction() {
+    removeFiles();
+    writeSome(WalOptions());
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        trie.compactHistoryLog();
+        CHECK(trie.ingestStats().compactions == 1);
+        CHECK(fileSize(walFile()) < 16);   // just the header
+        trie.submitUserWord("banana");
+        trie.flushEvents();
+    }
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        CHECK(trie.searchCount("apple") == 30);
+        CHECK(trie.userCount("banana") == 3);
+    }
+
+    // Passing the size limit wakes the snapshotter on its own
+    WalOptions options;
+    options.compactBytes = 256;
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile(), options));
+        for (int i = 0; i < 50; ++i) {
+            trie.submitUserWord("w" + std::to_string(i));
+            trie.flushEvents();
+        }
+        for (int i = 0; i < 1000 && trie.ingestStats().compactions == 0; ++i) {
+            usleep(1000);
+        }
+        IngestStats stats = trie.ingestStats();
+        CHECK(stats.compactions > 0);
+        CHECK(stats.lastSnapshotAgeMs >= 0);
+        CHECK(stats.maxSnapshotPauseMs >= stats.lastSnapshotPauseMs);
+    }
+    Trie trie;
+    CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+    CHECK(trie.userCount("w0") == 1);
+    CHECK(trie.userCount("w49") == 1);
+    CHECK(trie.userCount("banana") == 3);
+}
+
+static void checkPeriodicSnapshot() {
+    removeFiles();
+    WalOptions options;
+    options.compactInterval = std::chrono::seconds(1);
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile(), options));
+        CHECK(trie.ingestStats().snapshotIntervalMs == 1000);
+        CHECK(trie.ingestStats().lastSnapshotAgeMs < 0);
+        trie.submitUserWord("banana");
+        trie.flushEvents();
+        for (int i = 0; i < 3000 && trie.ingestStats().compactions == 0; ++i) {
+            usleep(1000);
+        }
+        CHECK(trie.ingestStats().compactions == 1);
+    }
+    CHECK(fileSize(snapshotFile()) > 0);
+    Trie trie;
+    CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+    CHECK(trie.userCount("banana") == 1);
+}
+
+static void checkInterruptedCompaction() {
+    removeFiles();
+    writeSome(WalOptions());
+    {
+        // Crash after the new snapshot landed but before the sealed log was
+        // removed: its records are below the checkpoint and must be skipped
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        std::ifstream in(walFile(), std::ios::binary);
+        std::ofstream out(walFile() + ".keep", std::ios::binary);
+        out << in.rdbuf();
+        out.close();
+        trie.compactHistoryLog();
+        std::rename((walFile() + ".keep").c_str(), (walFile() + ".old").c_str());
+    }
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        checkCounts(trie, 1);
+        trie.submitUserWord("banana");
+        trie.flushEvents();
+        // The sealed log is still there, so this compacts without rotating
+        trie.compactHistoryLog();
+        CHECK(fileSize(walFile() + ".old") == 0);
+    }
+    Trie trie;
+    CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+    CHECK(trie.searchCount("apple") == 30);
+    CHECK(trie.userCount("banana") == 3);
+}
+
+static vector<string> replayTexts(const string& path) {
+    vector<string> texts;
+    WriteAheadLog::replay(path, 0, [&texts](const WalRecord& record) {
+        texts.push_back(record.text);
+    });
+    return texts;
+}
+
+// Compaction syncs the new snapshot, renames it in, syncs the directory,
+// and only then removes the sealed log; if a sync fails the log stays
+static void checkCompactionOrder() {
+    removeFiles();
+    writeSome(WalOptions());
+    string temp = snapshotFile() + ".tmp";
+    string sealed = walFile() + ".old";
+    vector<string> syncs;
+    HistoryFile::setSyncHook([&](int fd, const string& path) {
+        syncs.push_back(path + (std::ifstream(temp).good() ? " temp" : " renamed") +
+                        (std::ifstream(sealed).good() ? " sealed" : " removed"));
+        return ::fsync(fd) == 0;
+    });
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        trie.compactHistoryLog();
+        CHECK(!std::ifstream(sealed).good());
+    }
+    CHECK(syncs == (vector<string>{temp + " temp sealed", dir + " renamed sealed"}));
+
+    HistoryFile::setSyncHook([](int, const string&) { return false; });
+    LogLevel level = Log::level();
+    Log::setLevel(LogLevel::Off);
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        trie.submitUserWord("banana");
+        trie.flushEvents();
+        trie.compactHistoryLog();
+        CHECK(std::ifstream(sealed).good());
+        CHECK(trie.ingestStats().compactions == 0);
+    }
+    Log::setLevel(level);
+    HistoryFile::setSyncHook({});
+    Trie trie;
+    CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+    CHECK(trie.searchCount("apple") == 30);
+    CHECK(trie.userCount("banana") == 3);
+}
+
+// A write that fails part way through a record (here: past a file size
+// limit, as with a full disk) is cut off, so later records still replay
+static void checkFailedAppend() {
+    string path = dir + "/failing.wal";
+    std::remove(path.c_str());
+    WriteAheadLog log{WalOptions()};
+    CHECK(log.open(path, 1));
+    CHECK(log.append(WalOp::UserWord, "before", 1) == 1);
+
+    std::signal(SIGXFSZ, SIG_IGN);   // fail with EFBIG instead
+    rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    rlimit small = limit;
+    small.rlim_cur = log.bytes() + 20;
+    CHECK(setrlimit(RLIMIT_FSIZE, &small) == 0);
+    LogLevel level = Log::level();
+    Log::setLevel(LogLevel::Off);
+    CHECK(log.append(WalOp::UserWord, "a word too long to fit under the limit", 1) == 0);
+    Log::setLevel(level);
+    CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+    std::signal(SIGXFSZ, SIG_DFL);
+
+    CHECK(log.failedAppends() == 1);
+    CHECK(log.append(WalOp::UserWord, "after", 1) == 2);
+    log.commit();
+    CHECK(replayTexts(path) == (vector<string>{"before", "after"}));
+    CHECK(fileSize(path) == log.bytes());
+    std::remove(path.c_str());
+}
+
+// A record longer than replay accepts is refused up front, so it cannot
+// cut off the records after it; the Trie refuses such text on submit
+static void checkOversizedRecord() {
+    string path = dir + "/oversized.wal";
+    std::remove(path.c_str());
+    {
+        WriteAheadLog log{WalOptions()};
+        CHECK(log.open(path, 1));
+        LogLevel level = Log::level();
+        Log::setLevel(LogLevel::Off);
+        CHECK(log.append(WalOp::UserWord, string(WriteAheadLog::kMaxText + 1, 'x'), 1) == 0);
+        Log::setLevel(level);
+        CHECK(log.failedAppends() == 1);
+        CHECK(log.append(WalOp::UserWord, string(WriteAheadLog::kMaxText, 'y'), 1) == 1);
+        CHECK(log.append(WalOp::UserWord, "after", 1) == 2);
+        log.commit();
+        CHECK(log.failedSyncs() == 0);
+    }
+    vector<string> texts = replayTexts(path);
+    CHECK(texts.size() == 2 && texts[0].size() == WriteAheadLog::kMaxText && texts[1] == "after");
+    std::remove(path.c_str());
+
+    removeFiles();
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        CHECK(!trie.submitCompleteSearch(string(Trie::kMaxTextBytes + 1, 'q')));
+        CHECK(trie.submitCompleteSearch("apple"));
+        trie.flushEvents();
+        IngestStats stats = trie.ingestStats();
+        CHECK(stats.dropped == 0 && stats.walFailedAppends == 0);
+    }
+    Trie trie;
+    CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+    CHECK(trie.searchCount("apple") == 10);
+}
+
+// A rotation whose rename fails leaves the log as it was
+static void checkFailedRotate() {
+    string path = dir + "/rotating.wal";
+    std::remove(path.c_str());
+    WriteAheadLog log{WalOptions()};
+    CHECK(log.open(path, 1));
+    log.append(WalOp::UserWord, "one", 1);
+    log.append(WalOp::UserWord, "two", 1);
+    uint64_t last = 0;
+    LogLevel level = Log::level();
+    Log::setLevel(LogLevel::Off);
+    CHECK(!log.rotate(dir + "/missing/rotating.wal.old", last));
+    Log::setLevel(level);
+    CHECK(last == 2);
+    CHECK(log.append(WalOp::UserWord, "three", 1) == 3);
+    log.commit();
+    CHECK(replayTexts(path) == (vector<string>{"one", "two", "three"}));
+
+    CHECK(log.rotate(path + ".old", last) && last == 3);
+    CHECK(replayTexts(path + ".old").size() == 3 && replayTexts(path).empty());
+    std::remove(path.c_str());
+    std::remove((path + ".old").c_str());
+}
+
+static void checkHistoryFormats() {
+    removeFiles();
+    string binary = dir + "/history.bin";
+    string text = dir + "/history.txt";
+    string back = dir + "/history.back";
+    {
+        Trie trie;
+        for (int i = 0; i < 3; ++i) trie.submitCompleteSearch("apple");
+        for (int i = 0; i < 5000; ++i) trie.submitUserWord("w" + std::to_string(i % 2500));
+        trie.flushEvents();
+        trie.saveUserHistory(binary);
+    }
+    CHECK(HistoryFile::convert(binary, text, true));
+    CHECK(HistoryFile::convert(text, back, false));
+    for (const string& file : {binary, text, back}) {
+        Trie trie;
+        trie.submitUserWord("apple");   // loaded counts replace this one
+        trie.flushEvents();
+        trie.loadUserHistory(file);
+        CHECK(trie.searchCount("apple") == 30);
+        CHECK(trie.userCount("apple") == 30);
+        CHECK(trie.userCount("w0") == 2);
+        CHECK(trie.userCount("w2499") == 2);
+    }
+    CHECK(fileSize(binary) < fileSize(text));
+    
+    // A text snapshot still opens the log, checkpoint included
+    std::ofstream(snapshotFile()) << "[CHECKPOINT] 7\n[USER_WORDS]\nbanana 4\n";
+    {
+        Trie trie;
+        CHECK(trie.openHistoryLog(snapshotFile(), walFile()));
+        CHECK(trie.userCount("banana") == 4);
+    }
+    
+    // Damage inside a block: nothing is loaded and the log stays closed, so
+    // no compaction can overwrite the file
+    {
+        std::fstream file(binary, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp((long)fileSize(binary) / 2);
+        file.put('\x7f');
+    }
+    Log::setLevel(LogLevel::Off);
+    Trie trie;
+    trie.loadUserHistory(binary);
+    CHECK(trie.userCount("w0") == 0);
+    CHECK(!trie.openHistoryLog(binary, walFile()));
+    Log::setLevel(LogLevel::Warn);
+    for (const string& file : {binary, text, back}) std::remove(file.c_str());
+}
+
+// saveToFile writes a front-coded file that loadFromFile reads back, into
+// an empty dictionary or adding to a loaded one; text still loads
+static void checkDictionaryRoundTrip() {
+    string file = dir + "/dictionary.fc";
+    {
+        Trie trie;
+        trie.insert("apple", 5);
+        trie.insert("apply", 1000000);
+        trie.insert("apt");
+        for (int i = 0; i < 26; ++i) trie.insert("word" + string(1, char('a' + i)), i + 1);
+        trie.saveToFile(file);
+    }
+    {
+        Trie trie;
+        trie.loadFromFile(file);
+        // More words than a top-k export would keep, the rarest included
+        CHECK(trie.search("apple") && trie.search("apply") && trie.search("apt"));
+        CHECK(trie.search("worda"));
+        CHECK(trie.autoCompleteSystem("word", 1) == (vector<string>{"wordz"}));
+        CHECK(trie.autoCompleteSystem("ap", 3) == (vector<string>{"apply", "apple", "apt"}));
+        trie.loadFromFile(file);   // counts add up
+        trie.insert("apt", 1999999);   // 2 + 1999999 passes 2 * 1000000
+        CHECK(trie.autoCompleteSystem("ap", 3) == (vector<string>{"apt", "apply", "apple"}));
+    }
+    string text = dir + "/dictionary.txt";
+    std::ofstream(text) << "apple,5\napt,7\n";
+    Trie trie;
+    trie.loadFromFile(text);
+    CHECK(trie.autoCompleteSystem("ap", 2) == (vector<string>{"apt", "apple"}));
+    std::remove(file.c_str());
+    std::remove(text.c_str());
+}
+
+int main() {
+    char pattern[] = "/tmp/persistence_testXXXXXX";
+    if (!mkdtemp(pattern)) {
+        std::cerr << "Cannot create a temporary directory\n";
+        return 1;
+    }
+    dir = pattern;
+
+    // The Trie's progress lines are not under test
+    Log::setLevel(LogLevel::Warn);
+    checkReplay();
+    checkTornTail();
+    checkCompaction();
+    checkPeriodicSnapshot();
+    checkInterruptedCompaction();
+    checkCompactionOrder();
+    checkFailedAppend();
+    checkOversizedRecord();
+    checkFailedRotate();
+    checkHistoryFormats();
+    checkDictionaryRoundTrip();
+    Log::setLevel(LogLevel::Info);
+
+    removeFiles();
+    rmdir(dir.c_str());
+    if (failures) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "persistence_test: OK\n";
+    return 0;
+}
@@ -0,0 +1,487 @@
+// Concurrency stress test for Trie and TrieNode.
+// Hammers one Trie from several threads with the same mix of calls the
+// crow handlers make, then checks that no update was lost, and checks that
+// lock-free TrieNode inserts behave like atomic operations, that readers
+// ride through dictionary hot reloads, and that the logger, the request
+// metrics and the slow-query log lose nothing under concurrent use, and that
+// ranking sees suggest hits once they are merged. Build
+// it with
+// `make tsan` to run it under ThreadSanitizer.
+#include "Trie.h"
+#include "Epoch.h"
+#include "HistoryFile.h"
+#include "Log.h"
+#include "RequestMetrics.h"
+#include "SlowQueryLog.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " \
+                      << #cond << "\n";                                    \
+            ++failures;                                                    \
+        }                                                                  \
+    } while (0)
+
+static string wordFor(int i) {
+    string w = "w";
+    for (int n = i; n > 0; n /= 26) w += char('a' + n % 26);
+    return w;
+}
+
+// Reads a saveUserHistory file back into its two count maps
+static void readHistory(const string& filename, std::unordered_map<string, int>& users,
+                        std::unordered_map<string, int>& searches) {
+    users.clear();
+    searches.clear();
+    uint64_t checkpoint;
+    CHECK(HistoryFile::read(filename, checkpoint,
+        [&](HistoryFile::Section section, std::string_view word, int count) {
+            (section == HistoryFile::Section::SearchHistory ? searches : users)[string(word)] = count;
+        }));
+}
+
+// Recounts wordCount from scratch and compares it with the stored counts
+static int verifyCounts(const TrieNode* node) {
+    int words = node->isEndOfWord ? 1 : 0;
+    for (int i = 0; i < 26; ++i) {
+        if (const TrieNode* child = node->child(i)) words += verifyCounts(child);
+    }
+    CHECK(node->wordCount == words);
+    return words;
+}
+
+// Writers insert disjoint words, plus one word they all share, while readers
+// check that every insert a writer has finished is visible (each completed
+// insert takes effect before it returns) and that counts never go backwards.
+static void checkConcurrentInserts() {
+    const int kWriters = 6;
+    const int kReaders = 3;
+    const int kWords = 3000;
+
+    TrieNode root;
+    std::atomic<int> progress[kWriters];
+    for (auto& p : progress) p.store(-1);
+    std::atomic<bool> done{false};
+
+    vector<std::thread> threads;
+    for (int t = 0; t < kWriters; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kWords; ++i) {
+                root.insert(string(1, char('a' + t)) + wordFor(i));
+                root.insert("shared");
+                progress[t].store(i, std::memory_order_release);
+            }
+        });
+    }
+    for (int r = 0; r < kReaders; ++r) {
+        threads.emplace_back([&, r] {
+            int lastShared = 0;
+            for (int n = 0; !done.load(); ++n) {
+                int t = (n + r) % kWriters;
+                int i = progress[t].load(std::memory_order_acquire);
+                if (i >= 0) CHECK(root.search(string(1, char('a' + t)) + wordFor(i)));
+
+                auto shared = root.getAllWithPrefix("shared", 1);
+                int freq = shared.empty() ? 0 : shared[0].second;
+                CHECK(freq >= lastShared);
+                lastShared = freq;
+            }
+        });
+    }
+    for (int t = 0; t < kWriters; ++t) threads[t].join();
+    done = true;
+    for (size_t t = kWriters; t < threads.size(); ++t) threads[t].join();
+
+    for (int t = 0; t < kWriters; ++t) {
+        for (int i = 0; i < kWords; i += 97) {
+            CHECK(root.search(string(1, char('a' + t)) + wordFor(i)));
+        }
+    }
+    auto shared = root.getAllWithPrefix("shared", 1);
+    CHECK(shared.size() == 1 && shared[0].second == kWriters * kWords);
+    verifyCounts(&root);
+
+    for (int i = 0; i < 26; ++i) TrieNode::destroyTree(root.child(i));
+}
+
+static void writeLines(const string& filename, const vector<string>& lines) {
+    std::ofstream out(filename);
+    for (const string& line : lines) out << line << "\n";
+}
+
+// Dictionaries are swapped while readers query them: every reader sees one
+// whole version or the other, and the history is left alone
+static void checkHotReload() {
+    const vector<string> first = {"vaa", "vab"};
+    const vector<string> second = {"vba", "vbb", "vbc"};
+    const string firstFile = "build/stress_dict_a.txt";
+    const string secondFile = "build/stress_dict_b.txt";
+    writeLines(firstFile, first);
+    writeLines(secondFile, second);
+
+    Trie trie;
+    CHECK(trie.buildFromSorted(firstFile) == 2);
+    trie.recordCompleteSearch("keep");
+
+    const int kReloads = 20;
+    std::atomic<bool> done{false};
+    vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                auto got = trie.autoCompleteSystem("v");
+                std::sort(got.begin(), got.end());
+                CHECK(got == first || got == second);
+            }
+        });
+    }
+    for (int i = 0; i < kReloads; ++i) {
+        CHECK(trie.reloadDictionary("", i % 2 == 0 ? secondFile : firstFile));
+        while (trie.reloadStats().running) std::this_thread::yield();
+    }
+    done.store(true);
+    for (auto& th : readers) th.join();
+
+    ReloadStats stats = trie.reloadStats();
+    CHECK(stats.completed == kReloads);
+    CHECK(stats.failed == 0);
+    CHECK(stats.lastWords == 2);
+    CHECK(trie.search("vab") && !trie.search("vba"));
+    CHECK(trie.userCount("keep") == 10 && trie.searchCount("keep") == 10);
+
+    CHECK(trie.reloadDictionary("", "build/missing_dictionary.txt"));
+    while (trie.reloadStats().running) std::this_thread::yield();
+    CHECK(trie.reloadStats().failed == 1);
+    CHECK(trie.search("vab"));
+    std::remove(firstFile.c_str());
+    std::remove(secondFile.c_str());
+}
+
+// Threads log concurrently through their own rings: every record is either
+// written whole, in its thread's order, or dropped and counted
+static void checkLogger() {
+    const int kThreads = 4;
+    const int kRecords = 20000;
+    char path[] = "/tmp/stress_logXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    Log::setOutput(fd);
+    Log::setLevel(LogLevel::Info);
+    uint64_t writtenBefore = Log::written();
+    uint64_t droppedBefore = Log::dropped();
+
+    vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([t] {
+            string padding(t * 40, 'x');
+            for (int i = 0; i < kRecords; ++i) {
+                LOG_INFO << "record " << t << " " << i << " " << 0.5 << " " << padding;
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    Log::flush();
+    Log::setLevel(LogLevel::Warn);
+    Log::setOutput(2);
+    uint64_t written = Log::written() - writtenBefore;
+    uint64_t dropped = Log::dropped() - droppedBefore;
+    CHECK(written + dropped == (uint64_t)kThreads * kRecords);
+    CHECK(written > 0);
+
+    std::ifstream in(path);
+    string line;
+    int last[kThreads];
+    std::fill(last, last + kThreads, -1);
+    uint64_t records = 0;
+    while (getline(in, line)) {
+        size_t start = line.find("] record ");
+        if (start == string::npos) {
+            CHECK(line.find("[WARNING ] Log buffer full; dropped ") != string::npos);
+            continue;
+        }
+        CHECK(line.compare(0, 1, "(") == 0 && line.find(") [INFO    ] ") == 20);
+        std::istringstream fields(line.substr(start + 9));
+        int t = -1, i = -1;
+        double half = 0;
+        string padding;
+        fields >> t >> i >> half >> padding;
+        CHECK(t >= 0 && t < kThreads && i > last[t] && half == 0.5);
+        CHECK(padding == string(t * 40, 'x'));
+        if (t >= 0 && t < kThreads) last[t] = i;
+        records++;
+    }
+    CHECK(records == written);
+    close(fd);
+    std::remove(path);
+}
+
+// Threads record into the same routes at once: every request is counted,
+// and the quantiles land in the right buckets
+static void checkRequestMetrics() {
+    const int kThreads = 4;
+    const int kRequests = 50000;
+    RequestMetrics metrics({"/api/suggest", "/api/search"});
+    CHECK(metrics.route("/api/search") == 1);
+    CHECK(metrics.route("/api/suggest?prefix=a") == 2);   // other
+
+    vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&metrics] {
+            // 1..1000 us on suggest, one 503 in a thousand on search
+            for (int i = 0; i < kRequests; ++i) {
+                metrics.record(0, 200, uint64_t(i % 1000 + 1) * 1000);
+                metrics.record(1, i % 1000 ? 200 : 503, 5000);
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    metrics.record(2, 404);
+
+    // Bucket bounds hold the value they are asked about, within 1/32
+    for (uint64_t ns : {0ull, 63ull, 64ull, 1000ull, 123456789ull, (1ull << 40) - 1}) {
+        size_t bucket = LatencyHistogram::bucketOf(ns);
+        CHECK(LatencyHistogram::lowestIn(bucket) <= ns && ns <= LatencyHistogram::highestIn(bucket));
+        CHECK(LatencyHistogram::highestIn(bucket) - LatencyHistogram::lowestIn(bucket) <= ns / 32);
+    }
+
+    string text = metrics.prometheus();
+    auto value = [&text](const string& series) {
+        size_t at = text.find(series + " ");
+        return at == string::npos ? -1.0 : std::stod(text.substr(at + series.size() + 1));
+    };
+    const string suggest = "autocomplete_request_duration_seconds{route=\"/api/suggest\",quantile=";
+    double p50 = value(suggest + "\"0.5\"}");
+    double p99 = value(suggest + "\"0.99\"}");
+    CHECK(p50 >= 500e-6 && p50 <= 500e-6 * 1.04);
+    CHECK(p99 >= 990e-6 && p99 <= 990e-6 * 1.04);
+    CHECK(value("autocomplete_request_duration_seconds_count{route=\"/api/suggest\"}") ==
+          kThreads * kRequests);
+    CHECK(value("autocomplete_requests_total{route=\"/api/search\",code=\"200\"}") ==
+          kThreads * (kRequests - kRequests / 1000));
+    CHECK(value("autocomplete_requests_total{route=\"/api/search\",code=\"503\"}") ==
+          kThreads * kRequests / 1000);
+    CHECK(value("autocomplete_requests_total{route=\"other\",code=\"404\"}") == 1);
+    CHECK(text.find("{route=\"other\",quantile=\"0.5\"} NaN") != string::npos);
+}
+
+// Only queries at or over the threshold are kept; the ring holds the newest
+// and the file gets every one, on its own channel
+static void checkSlowQueryLog() {
+    const int kThreads = 4;
+    const int kQueries = 400;   // few enough that no thread's log ring fills
+    char path[] = "/tmp/stress_slowXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+
+    SlowQueryLog slow(1000, 16);
+    CHECK(slow.enabled() && slow.open(path));
+    QueryTrace trace;
+    trace.dict.nodesVisited = 7287;
+    vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&slow, &trace, t] {
+            for (int i = 0; i < kQueries; ++i) {
+                // Every other query is fast enough to be ignored
+                slow.offer("p" + std::to_string(t) + "_" + std::to_string(i), i % 2 ? 999 : 1000, trace, true);
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    QueryTrace counts;
+    counts.dict.nodesVisited = 55;
+    slow.offer("untraced", 2000, counts, false);
+    slow.offer("last", 5000, trace, true);
+    Log::flush();
+
+    uint64_t expected = kThreads * kQueries / 2 + 2;
+    CHECK(slow.recorded() == expected);
+    vector<SlowQuery> recent = slow.recent();
+    CHECK(recent.size() == 16);
+    CHECK(recent.back().prefix == "last" && recent.back().totalNs == 5000);
+    CHECK(recent.back().traced && recent.back().trace.dict.nodesVisited == 7287);
+    CHECK(recent.back().threadId > 0);
+    CHECK(!recent[14].traced && recent[14].trace.dict.nodesVisited == 55);
+
+    std::ifstream in(path);
+    string line;
+    uint64_t lines = 0;
+    uint64_t untraced = 0;
+    while (getline(in, line)) {
+        CHECK(line.find("slow query prefix='") != string::npos);
+        if (line.find(" untraced ") != string::npos) {
+            CHECK(line.find(" dict_nodes=55 ") != string::npos);
+            untraced++;
+        } else {
+            CHECK(line.find(" dict_nodes=7287 ") != string::npos);
+        }
+        lines++;
+    }
+    CHECK(lines == expected && untraced == 1);
+    std::remove(path);
+
+    // One request in kTraceEvery is traced, per thread
+    unsigned sampled = 0;
+    for (unsigned i = 0; i < 4 * SlowQueryLog::kTraceEvery; ++i) sampled += slow.sampleTrace();
+    CHECK(sampled == 4);
+
+    SlowQueryLog off(0, 16);
+    off.offer("never", 1000000000, trace, true);
+    CHECK(!off.enabled() && off.recorded() == 0 && !off.sampleTrace());
+}
+
+// A query that is not timed still has the counts a slow-query line shows
+static void checkQueryCounts() {
+    Trie trie;
+    trie.insert("countaa", 2);
+    trie.insert("countab", 1);
+    trie.insertUserWord("countuser");
+    trie.flushEvents();
+    QueryTrace trace;
+    CHECK(trie.autoCompleteSystem("count", 5, &trace).size() == 3);
+    CHECK(trace.userCandidates == 1 && trace.dictConsulted && trace.dictCandidates == 2);
+    CHECK(trace.user.nodesVisited == 5 && trace.dict.nodesVisited == 4);
+    CHECK(trace.totalNs == 0 && trace.dict.traversalNs == 0);
+
+    trie.autoCompleteSystem("count", 5, &trace, true);
+    CHECK(trace.dict.nodesVisited == 4 && trace.totalNs > 0);
+}
+
+// Suggest hits count when ranking once merged, and not before
+static void checkMergedRanking() {
+    Trie trie;
+    trie.insert("rankaa", 5);
+    trie.insert("rankab", 1);
+    trie.setPrefixMerge(std::chrono::hours(1), 1 << 20);
+    CHECK(trie.autoCompleteSystem("rank", 2) == (vector<string>{"rankaa", "rankab"}));
+
+    vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&trie] { trie.autoCompleteSystem("rankab"); });
+    }
+    for (auto& th : threads) th.join();
+    CHECK(trie.searchCount("rankab") == 4);
+    CHECK(trie.autoCompleteSystem("rank", 2) == (vector<string>{"rankaa", "rankab"}));
+    trie.flushEvents();
+    CHECK(trie.ingestStats().prefixMerges > 0);
+    CHECK(trie.autoCompleteSystem("rank", 2) == (vector<string>{"rankab", "rankaa"}));
+}
+
+int main() {
+    Log::setLevel(LogLevel::Warn);  // the Trie's progress lines are not under test
+
+    checkConcurrentInserts();
+    checkHotReload();
+    checkLogger();
+    checkRequestMetrics();
+    checkSlowQueryLog();
+    checkQueryCounts();
+    checkMergedRanking();
+
+    const int kThreads = 8;
+    const int kOps = 400;
+    const string historyFile = "build/stress_history.bin";
+
+    Trie trie;
+    for (int i = 0; i < 500; ++i) trie.insert(wordFor(i));
+
+    std::atomic<int> suggestCalls{0};
+    vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kOps; ++i) {
+                switch (i % 4) {
+                case 0:
+                    trie.autoCompleteSystem("w" + string(1, char('a' + (i + t) % 26)));
+                    suggestCalls++;
+                    break;
+                case 1:
+                    trie.recordCompleteSearch("stress" + string(1, char('a' + t)));
+                    break;
+                case 2:
+                    trie.insertUserWord("user" + string(1, char('a' + t)));
+                    break;
+                case 3:
+                    if (i % 40 == 3) trie.saveUserHistory(historyFile);
+                    if (i % 8 == 7) trie.insert(wordFor(1000 + t));
+                    trie.search(wordFor(i));
+                    break;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    CHECK(suggestCalls == kThreads * kOps / 4);
+    for (int t = 0; t < kThreads; ++t) CHECK(trie.search(wordFor(1000 + t)));
+
+    // Every thread recorded kOps/4 complete searches (+10 each) and kOps/4
+    // user words (+1 each) under its own key; a lost update shows up here.
+    trie.saveUserHistory(historyFile);
+    std::unordered_map<string, int> users, searches;
+    readHistory(historyFile, users, searches);
+    for (int t = 0; t < kThreads; ++t) {
+        string searched = "stress" + string(1, char('a' + t));
+        string added = "user" + string(1, char('a' + t));
+        CHECK(searches[searched] == 10 * kOps / 4);
+        CHECK(users[searched] == 10 * kOps / 4);
+        CHECK(users[added] == kOps / 4);
+        auto top = trie.autoCompleteSystem(searched, 1);
+        CHECK(top.size() == 1 && top[0] == searched);
+    }
+    std::remove(historyFile.c_str());
+
+    // Asynchronous submissions and suggest prefixes are applied by the
+    // aggregator in batches
+    const int kSubmits = 300;
+    vector<std::thread> submitters;
+    for (int t = 0; t < kThreads; ++t) {
+        submitters.emplace_back([&, t] {
+            for (int i = 0; i < kSubmits; ++i) {
+                CHECK(trie.submitUserWord("async" + string(1, char('a' + t))));
+                trie.autoCompleteSystem("async" + string(1, char('a' + t)));
+            }
+        });
+    }
+    for (auto& th : submitters) th.join();
+    CHECK(trie.searchCount("asynca") == kSubmits);   // merged or still thread-local
+    trie.flushEvents();
+    IngestStats stats = trie.ingestStats();
+    CHECK(stats.dropped == 0);
+    CHECK(stats.depth == 0);
+    CHECK(stats.applied == stats.enqueued);
+    trie.saveUserHistory(historyFile);
+    readHistory(historyFile, users, searches);
+    for (int t = 0; t < kThreads; ++t) {
+        string word = "async" + string(1, char('a' + t));
+        CHECK(users[word] == kSubmits);
+        CHECK(searches[word] == kSubmits);
+    }
+    std::remove(historyFile.c_str());
+
+    // Every version replaced during the run is reclaimed once readers are gone
+    Epoch::drain();
+    CHECK(Epoch::pending() == 0);
+
+    Log::setLevel(LogLevel::Info);
+    if (failures) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "stress_test: OK\n";
+    return 0;
+}
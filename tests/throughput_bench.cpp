@@ -0,0 +1,67 @@
+// Suggest throughput benchmark for Trie.
+// Runs autoCompleteSystem from 1..N threads for a fixed time against a
+// synthetic dictionary, with one background writer recording searches, and
+// prints operations per second for each thread count.
+#include "Log.h"
+#include "Trie.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char** argv) {
+    int maxThreads = argc > 1 ? std::stoi(argv[1]) : (int)std::thread::hardware_concurrency();
+    if (maxThreads < 1) maxThreads = 1;
+    const auto duration = std::chrono::milliseconds(argc > 2 ? std::stoi(argv[2]) : 1000);
+
+    std::ostream report(std::cout.rdbuf());
+    Log::setLevel(LogLevel::Warn);  // silence the Trie's progress lines
+
+    Trie trie;
+    std::mt19937 rng(42);
+    for (int i = 0; i < 200000; ++i) {
+        string w;
+        int len = 3 + rng() % 8;
+        for (int j = 0; j < len; ++j) w += char('a' + rng() % 26);
+        trie.insert(w);
+    }
+
+    report << "threads,ops_per_sec\n";
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        std::atomic<bool> stop{false};
+        std::atomic<long> ops{0};
+
+        std::thread writer([&] {
+            int i = 0;
+            while (!stop) trie.recordCompleteSearch("bench" + string(1, char('a' + i++ % 26)));
+        });
+
+        vector<std::thread> readers;
+        for (int t = 0; t < threads; ++t) {
+            readers.emplace_back([&, t] {
+                long local = 0;
+                string prefix = "aa";
+                while (!stop) {
+                    prefix[0] = char('a' + (local + t) % 26);
+                    prefix[1] = char('a' + (local / 26) % 26);
+                    trie.autoCompleteSystem(prefix);
+                    ++local;
+                }
+                ops += local;
+            });
+        }
+
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        for (auto& th : readers) th.join();
+        writer.join();
+
+        double secs = std::chrono::duration<double>(duration).count();
+        report << threads << "," << (long)(ops / secs) << "\n";
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+    return 0;
+}